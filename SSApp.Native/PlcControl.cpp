@@ -1,7 +1,13 @@
 #include "framework.h"
 #include "PlcControl.h"
 #include "mcProtocol.h"
+#include "plcManager.h"
 #include "MvCameraControl.h"
+#include "cameraFrame.h"
+#include "cameraFramePool.h"
+#include "spscRing.h"
+#include "imageWriter.h"
+#include "tiffWriter.h"
 #include <thread>
 #include <chrono>
 #include <string>
@@ -11,21 +17,19 @@
 #include <atomic>
 #include <mutex>
 #include <memory>
+#include <condition_variable>
+#include <future>
+#include <deque>
+#include <algorithm>
+#include <functional>
 #include <direct.h> // For _mkdir
 #include <cstring>
+#include <cctype>
 #include <cstdlib> // For _TRUNCATE
 
-// Global state for persistent connection
-std::unique_ptr<MCProtocol> g_Plc;
-std::atomic<bool> g_IsConnected(false);
-std::atomic<int> g_LastD0Value(0); // Store the last read value
-std::mutex g_PlcMutex;
-
-// Reconnection Logic Globals
-std::string g_TargetIP;
-int g_TargetPort = 0;
-std::atomic<bool> g_ShouldReconnect(false);
-std::atomic<bool> g_ThreadRunning(false);
+// Devices touched every poll / scan, parsed once and checked at compile time
+constexpr MCProtocol::DeviceAddress g_PollDevice = "D0"_dev;
+constexpr MCProtocol::DeviceAddress g_ScanLightDevice = "Y1"_dev;
 
 // Camera Globals
 void* g_CamHandle = nullptr;
@@ -35,12 +39,87 @@ std::mutex g_CamMutex;
 std::atomic<bool> g_CaptureRequest(false);
 void* g_LiveViewHwnd = nullptr;
 MV_CC_DEVICE_INFO_LIST g_DeviceList = {0}; // Cache device list
+// SDK frame buffers. Display and capture return theirs at once; a frame leased to a
+// save in flight holds one until it is written.
+constexpr unsigned int g_CamImageNodes = 8;
+constexpr unsigned int g_CamMinImageNodes = 3;
+constexpr uint64_t g_CamPoolBytes = 512ull << 20; // fewer nodes for 20 MP+ sensors
+constexpr unsigned int g_CamPageSize = 4096;
+FramePool g_FramePool; // payload-sized grab nodes, registered with the SDK per polling live view
+
+// Camera trigger (SetCameraTriggerMode). Free run streams continuously; in the trigger
+// modes every frame is one exposure started by TriggerSoftware or an edge on a line.
+constexpr int g_TriggerFreeRun = 0;
+constexpr int g_TriggerSoftware = 1;
+constexpr int g_TriggerLine = 2;
+std::atomic<int> g_CamTriggerMode(g_TriggerFreeRun);
+
+// Acquisition (SetCameraAcquisitionMode, applied at the next StartLiveView). Polling runs
+// MV_CC_GetImageBuffer on the camera thread. In callback mode the SDK's grab thread only
+// leases each frame into g_FrameRing and returns; the dispatch thread displays it and
+// hands it to capture and scans. A full ring drops the frame on the spot, counted, so
+// the SDK always keeps g_CamRingSpareNodes grab nodes to fill.
+constexpr int g_AcquirePolling = 0;
+constexpr int g_AcquireCallback = 1;
+std::atomic<int> g_CamAcquisitionMode(g_AcquireCallback);
+constexpr unsigned int g_CamRingSpareNodes = 2;
+std::unique_ptr<SpscRing<FrameLease>> g_FrameRing;
+std::thread g_FrameDispatchThread;
+
+// Frame counters since StartLiveView (GetCameraFrameStats)
+struct FrameCounters {
+    std::atomic<uint64_t> received{ 0 };
+    std::atomic<uint64_t> delivered{ 0 };
+    std::atomic<uint64_t> dropped{ 0 };
+    std::atomic<uint64_t> lost{ 0 };
+    unsigned int lastFrameNum = 0; // acquiring thread only
+};
+FrameCounters g_FrameCounters;
+
+// Image writers (SetImageWriterOptions). Captures and scan images are queued here with
+// their frame lease; a queued image keeps its grab node until written.
+constexpr int g_WriterThreads = 2;
+constexpr int g_WriterMaxThreads = 8;
+constexpr int g_WriterQueueDepth = 4;
+constexpr int g_WriterMaxQueueDepth = 64;
+constexpr int g_WriterBlockTimeoutMs = 5000;
+constexpr int g_WriterStopTimeoutMs = 10000; // StopLiveView waits this long for queued images
+std::mutex g_WriterMutex;
+
+// Image file format (SetImageFormat), taken when an image is queued. By default the file
+// name's extension picks it; a set format also gives the file its extension.
+constexpr unsigned int g_JpegQualityDefault = 90;
+constexpr unsigned int g_JpegQualityMin = 51; // the SDK takes (50, 99]
+constexpr unsigned int g_JpegQualityMax = 99;
+struct ImageEncoding {
+    MV_SAVE_IAMGE_TYPE type = MV_Image_Undefined; // from the extension
+    unsigned int jpegQuality = g_JpegQualityDefault;
+};
+ImageEncoding g_ImageEncoding;
+std::mutex g_ImageEncodingMutex;
 
 // Capture Synchronization
 std::mutex g_CaptureMutex;
 std::condition_variable g_CaptureCV;
 bool g_CaptureFinished = false;
-std::string g_CaptureFilename;
+FrameLease g_CaptureFrame; // handed over with g_CaptureFinished; the capturing caller queues it
+
+// Frame hand-off to RunMultiLightScan, guarded by g_CaptureMutex and signalled on
+// g_CaptureCV: the camera thread leases out the first frame whose exposure began at or
+// after notBeforeMs (host clock, ms since the epoch like nHostTimeStamp)
+struct ScanFrameRequest {
+    bool pending = false;
+    int64_t notBeforeMs = 0;
+    int64_t exposureMs = 0; // fallback when frames carry no exposure time
+    bool triggered = false; // a trigger fired at notBeforeMs: the next frame to arrive is its exposure
+    FrameLease frame;       // set when ready
+};
+ScanFrameRequest g_ScanFrame;
+std::mutex g_ScanMutex; // one multi-light scan at a time
+
+constexpr int g_ScanMaxSteps = 32;
+constexpr int g_ScanMaxLights = 16;
+constexpr int g_ScanFrameTimeoutMs = 2000;
 
 void LogNative(const std::string& msg) {
     try {
@@ -51,50 +130,341 @@ void LogNative(const std::string& msg) {
     } catch (...) {}
 }
 
+// One I/O thread for all PLC traffic. Never destroyed: like the PLC workers it runs
+// until the process exits, so DLL unload never has to join it under the loader lock.
+MCEventLoop& GetPlcLoop() {
+    static MCEventLoop* loop = new MCEventLoop();
+    return *loop;
+}
+
+// Every PLC connection, opened by handle. Leaked for the same reason as the loop: the
+// detached workers may still be polling when statics are destroyed.
+PlcManager& GetPlcManager() {
+    static PlcManager* manager = new PlcManager(GetPlcLoop(), LogNative);
+    return *manager;
+}
+
+using PlcSession = std::shared_ptr<PlcManager::Session>;
+
+// Session behind the single-PLC exports (ConnectPlc, GetLastPlcValue, SetPlcBit, ...)
+PlcSession DefaultPlc() {
+    static PlcSession session = [] {
+        PlcSession s = GetPlcManager().create();
+        s->scheduler.addTag(g_PollDevice, 1, 500); // slot 0, read by GetLastPlcValue
+        return s;
+    }();
+    return session;
+}
+
+// Forwards a session's change batches to a C callback (nullptr stops them)
+void SetChangeCallback(PlcManager::Session& session, PlcChangeCallback callback) {
+    if (!callback) {
+        session.scheduler.setChangeListener(nullptr);
+        return;
+    }
+    session.scheduler.setChangeListener([callback](const std::vector<PlcPollScheduler::Change>& changes) {
+        std::vector<PlcTagChange> batch;
+        batch.reserve(changes.size());
+        for (const auto& c : changes) {
+            batch.push_back({ c.tagId, c.slot, c.value, c.previous });
+        }
+        callback(batch.data(), static_cast<int>(batch.size()));
+    });
+}
+
+// Session for a handle; 0 is the built-in one behind ConnectPlc
+PlcSession FindPlc(int handle) {
+    return handle == 0 ? DefaultPlc() : GetPlcManager().get(handle);
+}
+
+// Exported (C) and native forms of the socket options
+MCProtocol::SocketOptions ToSocketOptions(const PlcSocketOptions& o) {
+    MCProtocol::SocketOptions options;
+    options.noDelay = o.noDelay != 0;
+    options.keepAlive = o.keepAlive != 0;
+    options.keepAliveIdleMs = std::max(o.keepAliveIdleMs, 1);
+    options.keepAliveIntervalMs = std::max(o.keepAliveIntervalMs, 1);
+    options.sendBufferBytes = std::max(o.sendBufferBytes, 0);
+    options.receiveBufferBytes = std::max(o.receiveBufferBytes, 0);
+    options.connectTimeoutMs = std::max(o.connectTimeoutMs, 1);
+    options.responseTimeoutMs = std::max(o.responseTimeoutMs, 1);
+    options.transport = o.transport == 1 ? MCProtocol::Transport::UDP : MCProtocol::Transport::TCP;
+    options.udpRetries = std::clamp(o.udpRetries, 0, 10);
+    options.keepAliveProbes = std::clamp(o.keepAliveProbes, 1, 127);
+    return options;
+}
+
+PlcSocketOptions FromSocketOptions(const MCProtocol::SocketOptions& o) {
+    return { o.noDelay ? 1 : 0, o.keepAlive ? 1 : 0, o.keepAliveIdleMs, o.keepAliveIntervalMs,
+        o.sendBufferBytes, o.receiveBufferBytes, o.connectTimeoutMs, o.responseTimeoutMs,
+        o.transport == MCProtocol::Transport::UDP ? 1 : 0, o.udpRetries, o.keepAliveProbes };
+}
+
+// Connected session for a handle, or nullptr
+std::shared_ptr<MCProtocol> ConnectedPlc(int handle) {
+    PlcSession session = FindPlc(handle);
+    if (!session || !session->connected || !session->plc->isConnected()) {
+        return nullptr;
+    }
+    return session->plc;
+}
+
+// Image writer pool, replaced by SetImageWriterOptions. Like the PLC loop it is never
+// destroyed, so DLL unload never joins its threads under the loader lock.
+std::shared_ptr<ImageWriterPool>& ImageWriterSlot() {
+    static std::shared_ptr<ImageWriterPool>* writer = new std::shared_ptr<ImageWriterPool>(
+        std::make_shared<ImageWriterPool>(g_WriterThreads, g_WriterQueueDepth,
+            ImageWriterPool::Overflow::Block, std::chrono::milliseconds(g_WriterBlockTimeoutMs)));
+    return *writer;
+}
+
+std::shared_ptr<ImageWriterPool> GetImageWriter() {
+    std::lock_guard<std::mutex> lock(g_WriterMutex);
+    return ImageWriterSlot();
+}
+
 // Camera Helper
 void EnsureImagesFolder() {
     _mkdir("images");
 }
 
-void SaveImageFromBuffer(unsigned char* pData, unsigned int dataSize, MV_FRAME_OUT_INFO_EX* pFrameInfo, const std::string& customName = "") {
-    if (!pData || !pFrameInfo) return;
+// Pushes a written file out of the OS cache onto the disk
+bool FlushImageFile(const std::string& path) {
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr,
+        OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) return false;
+    bool flushed = FlushFileBuffers(file) != 0;
+    CloseHandle(file);
+    return flushed;
+}
+
+const char* ImageExtension(MV_SAVE_IAMGE_TYPE type) {
+    switch (type) {
+    case MV_Image_Jpeg: return ".jpg";
+    case MV_Image_Png: return ".png";
+    case MV_Image_Tif: return ".tif";
+    default: return ".bmp";
+    }
+}
 
-    EnsureImagesFolder();
-    
-    std::string filename;
-    if (!customName.empty()) {
-        filename = "images/" + customName;
-    } else {
+// The extension of a file name ("" if none), lower case
+std::string FileExtension(const std::string& name) {
+    size_t dot = name.find_last_of('.');
+    if (dot == std::string::npos || name.find_first_of("/\\", dot) != std::string::npos) return "";
+    std::string ext = name.substr(dot);
+    std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    return ext;
+}
+
+// MV_Image_Undefined for an extension that is not an image format we write
+MV_SAVE_IAMGE_TYPE ImageTypeForExtension(const std::string& ext) {
+    if (ext == ".jpg" || ext == ".jpeg") return MV_Image_Jpeg;
+    if (ext == ".png") return MV_Image_Png;
+    if (ext == ".tif" || ext == ".tiff") return MV_Image_Tif;
+    if (ext == ".bmp") return MV_Image_Bmp;
+    return MV_Image_Undefined;
+}
+
+// Settles the file type and name. The extension picks the type unless a format is set;
+// a missing or unknown extension, or one that doesn't match the type, is replaced, so
+// the name always says what the file holds (BMP when nothing else decides). 'fileName'
+// comes back as the name under images/.
+MV_SAVE_IAMGE_TYPE ResolveImageFile(const std::string& customName, MV_SAVE_IAMGE_TYPE format, std::string& fileName) {
+    std::string name = customName;
+    if (name.empty()) {
         // Generate filename based on timestamp
         auto now = std::chrono::system_clock::now();
         auto timestamp = std::chrono::duration_cast<std::chrono::milliseconds>(now.time_since_epoch()).count();
-        filename = "images/img_" + std::to_string(timestamp) + ".bmp";
+        name = "img_" + std::to_string(timestamp);
+    }
+    std::string ext = FileExtension(name);
+    MV_SAVE_IAMGE_TYPE extType = ImageTypeForExtension(ext);
+    MV_SAVE_IAMGE_TYPE type = format != MV_Image_Undefined ? format
+        : extType != MV_Image_Undefined ? extType : MV_Image_Bmp;
+    if (extType != type) {
+        name = name.substr(0, name.size() - ext.size()) + ImageExtension(type);
+    }
+    fileName = name;
+    return type;
+}
+
+// Writes images/<fileName> as settled by ResolveImageFile. Writer threads only; images/
+// is made by StartLiveView
+bool SaveImageFromBuffer(void* camHandle, unsigned char* pData, MV_FRAME_OUT_INFO_EX* pFrameInfo, const std::string& fileName,
+    MV_SAVE_IAMGE_TYPE type, unsigned int jpegQuality, bool flush = false) {
+    if (!camHandle || !pData || !pFrameInfo) return false;
+
+    std::string filename = "images/" + fileName;
+
+    // Mono10/12/16 keep their depth in TIFF, which the SDK would cut to 8 bits
+    if (type == MV_Image_Tif && MonoTiffBits(pFrameInfo->enPixelType) != 0) {
+        if (!WriteMonoTiff16(filename, pData, pFrameInfo->nFrameLen, pFrameInfo->nWidth, pFrameInfo->nHeight, pFrameInfo->enPixelType)) {
+            LogNative("Failed to write 16-bit TIFF: " + filename);
+            return false;
+        }
+    }
+    else {
+        MV_SAVE_IMAGE_TO_FILE_PARAM_EX stSaveParam;
+        memset(&stSaveParam, 0, sizeof(MV_SAVE_IMAGE_TO_FILE_PARAM_EX));
+        stSaveParam.enPixelType = pFrameInfo->enPixelType;
+        stSaveParam.nWidth = pFrameInfo->nWidth;
+        stSaveParam.nHeight = pFrameInfo->nHeight;
+        stSaveParam.pData = pData;
+        stSaveParam.nDataLen = pFrameInfo->nFrameLen;
+        stSaveParam.enImageType = type;
+        stSaveParam.nQuality = jpegQuality;
+        stSaveParam.pcImagePath = const_cast<char*>(filename.c_str());
+
+        int nRet = MV_CC_SaveImageToFileEx(camHandle, &stSaveParam);
+        if (nRet != MV_OK) {
+            LogNative("Failed to save image: " + std::to_string(nRet));
+            return false;
+        }
+    }
+    if (flush && !FlushImageFile(filename)) {
+        LogNative("Failed to flush image: " + filename);
+        return false;
+    }
+    LogNative("Image saved: " + filename);
+    return true;
+}
+
+bool SaveFrame(const CameraFrame& frame, const std::string& fileName, MV_SAVE_IAMGE_TYPE type, unsigned int jpegQuality, bool flush = false) {
+    MV_FRAME_OUT_INFO_EX info = frame.info();
+    return SaveImageFromBuffer(frame.camera(), frame.data(), &info, fileName, type, jpegQuality, flush);
+}
+
+// Queues the frame for the writer pool, in the format set now; the future is invalid if
+// the queue turned it away. 'fileName' comes back as the name it gets under images/,
+// which the format can change (ResolveImageFile).
+std::future<bool> QueueSave(FrameLease frame, const std::string& customName, std::string& fileName, bool flush = false) {
+    ImageEncoding encoding;
+    {
+        std::lock_guard<std::mutex> lock(g_ImageEncodingMutex);
+        encoding = g_ImageEncoding;
     }
+    MV_SAVE_IAMGE_TYPE type = ResolveImageFile(customName, encoding.type, fileName);
+    std::future<bool> result = GetImageWriter()->submit(
+        [frame = std::move(frame), fileName, type, quality = encoding.jpegQuality, flush]() {
+            return SaveFrame(*frame, fileName, type, quality, flush);
+        });
+    if (!result.valid()) {
+        LogNative("Image writer queue full, not saved: " + fileName);
+    }
+    return result;
+}
+
+int64_t HostNowMs() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+// Gives the frame to a waiting scan if its exposure started late enough. Arrival minus
+// exposure is too late an estimate of the start, since readout and transfer come on
+// top; in free run they fit within one frame period, so the last interval is taken off too.
+void OfferScanFrame(const FrameLease& frame, int64_t arrivalMs, int64_t intervalMs) {
+    std::lock_guard<std::mutex> lk(g_CaptureMutex);
+    if (!g_ScanFrame.pending) return;
+    const MV_FRAME_OUT_INFO_EX& info = frame->info();
+    int64_t exposureMs = std::max<int64_t>(g_ScanFrame.exposureMs,
+        static_cast<int64_t>(info.fExposureTime / 1000.0f) + 1);
+    int64_t startMs = g_ScanFrame.triggered ? arrivalMs : arrivalMs - exposureMs - intervalMs;
+    if (startMs < g_ScanFrame.notBeforeMs) return;
+
+    g_ScanFrame.frame = frame;
+    g_ScanFrame.pending = false;
+    g_CaptureCV.notify_all();
+}
 
-    MV_SAVE_IMAGE_TO_FILE_PARAM_EX stSaveParam;
-    memset(&stSaveParam, 0, sizeof(MV_SAVE_IMAGE_TO_FILE_PARAM_EX));
-    stSaveParam.enPixelType = pFrameInfo->enPixelType;
-    stSaveParam.nWidth = pFrameInfo->nWidth;
-    stSaveParam.nHeight = pFrameInfo->nHeight;
-    stSaveParam.pData = pData;
-    stSaveParam.nDataLen = pFrameInfo->nFrameLen;
-    stSaveParam.enImageType = MV_Image_Bmp;
-    stSaveParam.pcImagePath = const_cast<char*>(filename.c_str());
+// Asks the camera thread for the first frame exposed after notBeforeMs. With a trigger,
+// 'fire' starts that exposure once the request is posted, so its frame cannot be missed.
+FrameLease WaitScanFrame(int64_t notBeforeMs, int64_t exposureMs, const std::function<bool()>& fire, int timeoutMs) {
+    std::unique_lock<std::mutex> lock(g_CaptureMutex);
+    g_ScanFrame.pending = true;
+    g_ScanFrame.frame = nullptr;
+    g_ScanFrame.notBeforeMs = notBeforeMs;
+    g_ScanFrame.exposureMs = exposureMs;
+    g_ScanFrame.triggered = g_CamTriggerMode != g_TriggerFreeRun;
+    if (fire) {
+        lock.unlock();
+        bool fired = fire();
+        lock.lock();
+        if (!fired) {
+            g_ScanFrame.pending = false;
+            return nullptr;
+        }
+    }
+    g_CaptureCV.wait_for(lock, std::chrono::milliseconds(timeoutMs), [] { return g_ScanFrame.frame != nullptr; });
+    g_ScanFrame.pending = false;
+    return std::move(g_ScanFrame.frame);
+}
 
-    int nRet = MV_CC_SaveImageToFileEx(g_CamHandle, &stSaveParam);
+// Starts one exposure in software trigger mode
+bool FireSoftwareTrigger() {
+    std::lock_guard<std::mutex> lock(g_CamMutex);
+    if (!g_CamHandle) return false;
+    int nRet = MV_CC_SetCommandValue(g_CamHandle, "TriggerSoftware");
     if (nRet != MV_OK) {
-        LogNative("Failed to save image: " + std::to_string(nRet));
-    } else {
-        LogNative("Image saved: " + filename);
+        LogNative("TriggerSoftware failed: " + std::to_string(nRet));
+        return false;
+    }
+    return true;
+}
+
+// Counts a frame as it comes off the SDK; a jump in the camera's frame number means
+// frames were lost before reaching us (no free grab node, lost packets)
+void CountFrame(const MV_FRAME_OUT_INFO_EX& info) {
+    g_FrameCounters.received.fetch_add(1, std::memory_order_relaxed);
+    unsigned int last = g_FrameCounters.lastFrameNum;
+    if (last != 0 && info.nFrameNum > last + 1) {
+        g_FrameCounters.lost.fetch_add(info.nFrameNum - last - 1, std::memory_order_relaxed);
     }
+    g_FrameCounters.lastFrameNum = info.nFrameNum;
+}
+
+// Display, scan hand-off and capture for one frame, on the camera or dispatch thread
+void ProcessFrame(const FrameLease& frame, int64_t& lastArrivalMs) {
+    const MV_FRAME_OUT_INFO_EX& stImageInfo = frame->info();
+    int64_t arrivalMs = stImageInfo.nHostTimeStamp ? stImageInfo.nHostTimeStamp : HostNowMs();
+    int64_t intervalMs = lastArrivalMs ? std::max<int64_t>(arrivalMs - lastArrivalMs, 0) : 0;
+    lastArrivalMs = arrivalMs;
+
+    // 1. Display
+    if (g_LiveViewHwnd) {
+        MV_DISPLAY_FRAME_INFO stDisplayInfo = {0};
+        stDisplayInfo.hWnd = g_LiveViewHwnd;
+        stDisplayInfo.pData = frame->data();
+        stDisplayInfo.nDataLen = stImageInfo.nFrameLen;
+        stDisplayInfo.nWidth = stImageInfo.nWidth;
+        stDisplayInfo.nHeight = stImageInfo.nHeight;
+        stDisplayInfo.enPixelType = stImageInfo.enPixelType;
+        
+        MV_CC_DisplayOneFrame(g_CamHandle, &stDisplayInfo);
+    }
+
+    // 2. Hand a fresh enough frame to a running multi-light scan
+    OfferScanFrame(frame, arrivalMs, intervalMs);
+
+    // 3. Capture if requested: handed to the waiting caller, which queues the write, so
+    // a full writer queue never holds up this thread
+    if (g_CaptureRequest) {
+        {
+            std::lock_guard<std::mutex> lk(g_CaptureMutex);
+            if (g_CaptureRequest) {
+                g_CaptureFrame = frame;
+                g_CaptureRequest = false;
+                g_CaptureFinished = true;
+            }
+        }
+        g_CaptureCV.notify_all();
+    }
+    g_FrameCounters.delivered.fetch_add(1, std::memory_order_relaxed);
 }
 
 void CameraLoop() {
     LogNative("Camera Thread Started");
     
-    MV_FRAME_OUT_INFO_EX stImageInfo = {0};
-    unsigned char* pData = (unsigned char*)malloc(sizeof(unsigned char) * (1920 * 1200 * 3 + 2048)); // Alloc buffer (adjust size as needed, using safe large default)
-    if (!pData) return;
+    int64_t lastArrivalMs = 0;
 
     while (g_CamLiveViewRunning) {
         if (!g_CamHandle) {
@@ -102,182 +472,72 @@ void CameraLoop() {
              continue;
         }
 
-        int nRet = MV_CC_GetOneFrameTimeout(g_CamHandle, pData, 1920 * 1200 * 3 + 2048, &stImageInfo, 1000);
-        if (nRet == MV_OK) {
-            // 1. Display
-            if (g_LiveViewHwnd) {
-                MV_DISPLAY_FRAME_INFO stDisplayInfo = {0};
-                stDisplayInfo.hWnd = g_LiveViewHwnd;
-                stDisplayInfo.pData = pData;
-                stDisplayInfo.nDataLen = stImageInfo.nFrameLen;
-                stDisplayInfo.nWidth = stImageInfo.nWidth;
-                stDisplayInfo.nHeight = stImageInfo.nHeight;
-                stDisplayInfo.enPixelType = stImageInfo.enPixelType;
-                
-                MV_CC_DisplayOneFrame(g_CamHandle, &stDisplayInfo);
-            }
-
-            // 2. Capture if requested
-            if (g_CaptureRequest) {
-                std::string fname;
-                {
-                     std::lock_guard<std::mutex> lk(g_CaptureMutex);
-                     fname = g_CaptureFilename;
-                }
-                SaveImageFromBuffer(pData, stImageInfo.nFrameLen, &stImageInfo, fname);
-                
-                {
-                    std::lock_guard<std::mutex> lk(g_CaptureMutex);
-                    g_CaptureFinished = true;
-                }
-                g_CaptureCV.notify_all();
-                g_CaptureRequest = false;
-            }
+        // Used in place in the SDK's buffer; it goes back when the last user drops it
+        FrameLease frame = AcquireFrame(g_CamHandle, 1000);
+        if (frame) {
+            CountFrame(frame->info());
+            ProcessFrame(frame, lastArrivalMs);
         }
     }
 
-    free(pData);
     LogNative("Camera Thread Stopped");
 }
 
-void ConnectionManager() {
-    LogNative("ConnectionManager Thread Started");
-    g_ThreadRunning = true;
-    while (true) {
-        bool shouldRun = g_ShouldReconnect;
-        
-        // 1. If we shouldn't be connected, ensure we are disconnected and wait
-        if (!shouldRun) {
-            bool wasConnected = false;
-            {
-                std::lock_guard<std::mutex> lock(g_PlcMutex);
-                if (g_Plc && g_Plc->isConnected()) {
-                    g_Plc->disconnect();
-                    wasConnected = true;
-                }
-            }
-            if (wasConnected) {
-                g_IsConnected = false;
-                LogNative("Manager: Forced Disconnect (shouldRun=false)");
-            }
-            
-            std::this_thread::sleep_for(std::chrono::milliseconds(200));
-            continue;
-        }
+// SDK grab thread (MV_CC_RegisterImageCallBackEx2, no auto-free): lease the frame in
+// place and queue it, never waiting. Dropped here, it goes straight back to the SDK.
+void __stdcall OnCameraFrame(MV_FRAME_OUT* pstFrame, void* pUser, bool bAutoFree) {
+    if (!pstFrame || !pstFrame->pBufAddr || bAutoFree) return;
 
-        // 2. Check Connection State
-        bool currentConnected = false;
-        {
-            std::lock_guard<std::mutex> lock(g_PlcMutex);
-            if (g_Plc) currentConnected = g_Plc->isConnected();
-        }
-        g_IsConnected = currentConnected;
-
-        if (currentConnected) {
-            // --- POLLING PHASE ---
-            {
-                std::lock_guard<std::mutex> lock(g_PlcMutex);
-                if (g_Plc && g_Plc->isConnected()) {
-                    try {
-                        // Read D0 (1 word)
-                        auto result = g_Plc->read_sign_word("D0", 1); 
-                        if (!result.empty()) {
-                            g_LastD0Value = result[0];
-                        }
-                    }
-                    catch (const std::exception& ex) {
-                        LogNative(std::string("Polling error: ") + ex.what());
-                        g_IsConnected = false; 
-                        try { g_Plc->disconnect(); } catch (...) {}
-                    }
-                }
-                else {
-                     g_IsConnected = false;
-                }
-            }
-            // Poll interval
-            std::this_thread::sleep_for(std::chrono::milliseconds(500));
-        } 
-        else {
-            // --- RECONNECTION PHASE ---
-            std::string ip;
-            int port;
-            {
-                std::lock_guard<std::mutex> lock(g_PlcMutex);
-                ip = g_TargetIP;
-                port = g_TargetPort;
-            }
+    FrameLease frame = std::make_shared<const CameraFrame>(pUser, *pstFrame);
+    CountFrame(frame->info());
+    if (!g_CamLiveViewRunning) return;
+    if (!g_FrameRing->push(std::move(frame))) {
+        g_FrameCounters.dropped.fetch_add(1, std::memory_order_relaxed);
+    }
+}
 
-            if (!ip.empty() && port > 0) {
-                // Try to connect
-                bool success = false;
-                LogNative("Manager: Attempting to connect to " + ip + ":" + std::to_string(port));
-                
-                {
-                    std::lock_guard<std::mutex> lock(g_PlcMutex);
-                    if (!g_Plc) g_Plc = std::make_unique<MCProtocol>();
-                    
-                    try {
-                        if (g_Plc->connect(ip, port)) {
-                            success = true;
-                        }
-                    }
-                    catch (const std::exception& ex) {
-                        LogNative(std::string("Connection exception: ") + ex.what());
-                    }
-                }
-
-                if (success) {
-                    g_IsConnected = true;
-                    LogNative("Manager: Connected successfully.");
-                    // Proceed immediately to polling next loop
-                } else {
-                    LogNative("Manager: Connection failed. Retrying in 5s...");
-                    // Retry Delay (5 Seconds)
-                    std::this_thread::sleep_for(std::chrono::seconds(5));
-                }
-            } else {
-                // Missing config
-                std::this_thread::sleep_for(std::chrono::milliseconds(500));
-            }
+// Sole consumer of g_FrameRing while live view runs
+void FrameDispatchLoop() {
+    LogNative("Frame Dispatch Thread Started");
+
+    int64_t lastArrivalMs = 0;
+    FrameLease frame;
+
+    while (g_CamLiveViewRunning) {
+        if (g_FrameRing->pop(frame)) {
+            ProcessFrame(frame, lastArrivalMs);
+            frame.reset();
+        }
+        else {
+            g_FrameRing->wait();
         }
     }
-}
 
-void EnsureThreadStarted() {
-    static std::once_flag flag;
-    std::call_once(flag, []() {
-        std::thread t(ConnectionManager);
-        t.detach();
-    });
+    LogNative("Frame Dispatch Thread Stopped");
 }
 
-
 // ---------------------------------------------------------
 // EXPORTED FUNCTIONS
 // ---------------------------------------------------------
 bool ConnectPlc(const char* ipAddress, int port) {
     LogNative("ConnectPlc called: " + std::string(ipAddress) + ":" + std::to_string(port));
     
-    // Update target
-    {
-        std::lock_guard<std::mutex> lock(g_PlcMutex);
-        g_TargetIP = ipAddress;
-        g_TargetPort = port;
-    }
-    
-    // Signal manager
-    g_ShouldReconnect = true;
-    
-    // Ensure thread is running
-    EnsureThreadStarted();
+    // Update target and signal the session's worker
+    PlcSession session = DefaultPlc();
+    session->setTarget(ipAddress, port);
+    session->shouldConnect = true;
     
     return true; 
 }
 
+bool ConnectPlcEx(const char* ipAddress, int port, const PlcSocketOptions* options) {
+    if (options && !PlcSetSocketOptions(0, options)) return false;
+    return ConnectPlc(ipAddress, port);
+}
+
 void DisconnectPlc() {
     LogNative("DisconnectPlc called");
-    g_ShouldReconnect = false;
+    DefaultPlc()->shouldConnect = false;
 }
 
 int GetCameraCount() {
@@ -352,34 +612,126 @@ void StartLiveView(void* hWnd, int deviceIndex) {
         return;
     }
 
+    // Live view always starts free running; SetCameraTriggerMode switches afterwards
+    nRet = MV_CC_SetEnumValue(g_CamHandle, "TriggerMode", MV_TRIGGER_MODE_OFF);
+    if (MV_OK != nRet) {
+        LogNative("TriggerMode Off failed: " + std::to_string(nRet));
+    }
+    g_CamTriggerMode = g_TriggerFreeRun;
+
+    // Grab nodes sized from PayloadSize. Polling grabs into our own page-aligned buffers.
+    // The SDK documents registered buffers only with GetImageBuffer and the plain Ex
+    // callback, so callback mode sets the same number of SDK-allocated nodes instead; the
+    // Ex2 callback still leases those in place. SDK nodes are also the polling fallback.
+    bool useCallback = g_CamAcquisitionMode == g_AcquireCallback;
+    uint64_t payloadSize = 0;
+    unsigned int alignment = 0;
+    unsigned int nodes = g_CamImageNodes;
+    int registered = 0;
+    nRet = MV_CC_GetPayloadSize(g_CamHandle, &payloadSize, &alignment);
+    if (nRet == MV_OK && payloadSize > 0) {
+        nodes = static_cast<unsigned int>(std::clamp<uint64_t>(g_CamPoolBytes / payloadSize, g_CamMinImageNodes, g_CamImageNodes));
+        if (!useCallback && g_FramePool.reserve(payloadSize, std::max(alignment, g_CamPageSize), static_cast<int>(nodes))) {
+            registered = g_FramePool.registerWith(g_CamHandle, static_cast<int>(nodes));
+        }
+    }
+    if (registered > 0) {
+        LogNative("Frame pool: " + std::to_string(registered) + " x " + std::to_string(payloadSize) + " bytes");
+    }
+    else {
+        if (!useCallback) {
+            LogNative("Frame pool unavailable (" + std::to_string(nRet) + "), using SDK buffers");
+        }
+        nRet = MV_CC_SetImageNodeNum(g_CamHandle, nodes);
+        if (MV_OK != nRet) {
+            LogNative("SetImageNodeNum failed: " + std::to_string(nRet));
+        }
+    }
+
+    // Frames by callback unless polling was asked for or the SDK turns the callback down
+    if (useCallback) {
+        g_FrameRing = std::make_unique<SpscRing<FrameLease>>(nodes > g_CamRingSpareNodes ? nodes - g_CamRingSpareNodes : 1);
+        nRet = MV_CC_RegisterImageCallBackEx2(g_CamHandle, OnCameraFrame, g_CamHandle, false);
+        if (MV_OK != nRet) {
+            LogNative("RegisterImageCallBackEx2 failed: " + std::to_string(nRet) + ", polling");
+            useCallback = false;
+        }
+    }
+    g_FrameCounters.received = 0;
+    g_FrameCounters.delivered = 0;
+    g_FrameCounters.dropped = 0;
+    g_FrameCounters.lost = 0;
+    g_FrameCounters.lastFrameNum = 0;
+
     // 4. Start Grabbing
     nRet = MV_CC_StartGrabbing(g_CamHandle);
     if (MV_OK != nRet) {
         LogNative("StartGrabbing failed: " + std::to_string(nRet));
+        g_FramePool.unregisterFrom(g_CamHandle);
         MV_CC_CloseDevice(g_CamHandle);
         MV_CC_DestroyHandle(g_CamHandle);
         g_CamHandle = nullptr;
         return;
     }
 
+    EnsureImagesFolder();
     g_LiveViewHwnd = hWnd;
     g_CamLiveViewRunning = true;
-    g_CamThread = std::thread(CameraLoop);
-    g_CamThread.detach();
+    if (useCallback) {
+        g_FrameDispatchThread = std::thread(FrameDispatchLoop);
+    }
+    else {
+        g_CamThread = std::thread(CameraLoop);
+    }
 }
 
 void StopLiveView() {
     LogNative("StopLiveView called");
     g_CamLiveViewRunning = false;
-    
-    // Wait slightly for thread to exit loop
-    std::this_thread::sleep_for(std::chrono::milliseconds(200)); 
+
+    // Once the dispatch thread is gone, this thread is the only one to empty the ring
+    if (g_FrameDispatchThread.joinable()) {
+        g_FrameRing->close();
+        g_FrameDispatchThread.join();
+    }
+
+    // The polling thread may be inside AcquireFrame (up to its 1 s timeout); once it has
+    // returned, no new lease can be taken behind the drain below
+    if (g_CamThread.joinable()) {
+        g_CamThread.join();
+    }
+
+    // Queued images hold frame leases; write them out while the camera is still there
+    if (!GetImageWriter()->waitIdle(std::chrono::milliseconds(g_WriterStopTimeoutMs))) {
+        LogNative("StopLiveView: image writes still pending after " + std::to_string(g_WriterStopTimeoutMs) + " ms");
+    }
+
+    // Leased frames must go back to the SDK before the handle does (a callback that
+    // queued one as the dispatch thread stopped, a writer just letting go)
+    for (int i = 0; i < 50; ++i) {
+        FrameLease queued;
+        while (g_FrameRing && g_FrameRing->pop(queued)) {
+            queued.reset();
+        }
+        if (CameraFrame::leased() == 0) break;
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
     
     std::lock_guard<std::mutex> lock(g_CamMutex);
     if (g_CamHandle) {
         MV_CC_StopGrabbing(g_CamHandle);
-        MV_CC_CloseDevice(g_CamHandle);
-        MV_CC_DestroyHandle(g_CamHandle);
+        int leased = CameraFrame::leased();
+        if (leased == 0) {
+            g_FramePool.unregisterFrom(g_CamHandle);
+            MV_CC_CloseDevice(g_CamHandle);
+            MV_CC_DestroyHandle(g_CamHandle);
+        }
+        else {
+            // A lease still frees its buffer through this handle, whenever it is let go;
+            // leak the handle and its grab nodes rather than free them under it
+            LogNative("StopLiveView: " + std::to_string(leased) + " frame(s) still leased, leaking camera handle");
+            g_FramePool.abandon();
+        }
         g_CamHandle = nullptr;
     }
     LogNative("StopLiveView finished");
@@ -388,36 +740,209 @@ void StopLiveView() {
 
 
 void StartScanNative(const char* /*ipAddress*/, int /*port*/) {
-    std::thread t([]() {
-        if (g_IsConnected) {
-             {
-                 std::lock_guard<std::mutex> lock(g_PlcMutex);
-                 if (g_Plc && g_Plc->isConnected()) {
-                     try {
-                        g_Plc->write_bit("Y1", { 1 });
-                     } catch (...) {}
-                 }
-             }
-             std::this_thread::sleep_for(std::chrono::seconds(5));
-             {
-                 std::lock_guard<std::mutex> lock(g_PlcMutex);
-                 if (g_Plc && g_Plc->isConnected()) {
-                     try {
-                        g_Plc->write_bit("Y1", { 0 });
-                     } catch (...) {}
-                 }
-             }
-        }
+    // Y1 on now, off again in 5s - both driven by the PLC event loop, no thread per scan
+    std::shared_ptr<MCProtocol> plc = ConnectedPlc(0);
+    if (!plc) return;
+    try {
+        plc->async_write_bit(g_ScanLightDevice, { 1 }, [](bool, std::exception_ptr) {});
+    } catch (...) {}
+
+    GetPlcLoop().schedule(std::chrono::seconds(5), [plc]() {
+        if (!plc->isConnected()) return;
+        try {
+            plc->async_write_bit(g_ScanLightDevice, { 0 }, [](bool, std::exception_ptr) {});
+        } catch (...) {}
     });
-    t.detach();
 }
 
 int GetLastPlcValue() {
-    return g_LastD0Value;
+    return DefaultPlc()->image.get(0);
+}
+
+int GetPlcSnapshot(int* buffer, int len) {
+    return PlcGetSnapshot(0, buffer, len);
+}
+
+int AddPlcPollTag(const char* headdevice, int points, int periodMs) {
+    return PlcAddPollTag(0, headdevice, points, periodMs);
+}
+
+bool RemovePlcPollTag(int tagId) {
+    return DefaultPlc()->scheduler.removeTag(tagId);
+}
+
+void ClearPlcPollTags() {
+    DefaultPlc()->scheduler.clear();
+}
+
+void RegisterPlcChangeCallback(PlcChangeCallback callback) {
+    SetChangeCallback(*DefaultPlc(), callback);
+}
+
+bool WatchPlcTag(int tagId, int deadband) {
+    return DefaultPlc()->scheduler.watch(tagId, deadband);
+}
+
+bool UnwatchPlcTag(int tagId) {
+    return DefaultPlc()->scheduler.unwatch(tagId);
 }
 
 bool GetIsConnected() {
-    return g_IsConnected;
+    return DefaultPlc()->connected;
+}
+
+// ---------------------------------------------------------
+// MULTI-PLC (HANDLE) API
+// ---------------------------------------------------------
+
+int PlcOpen(const char* ipAddress, int port) {
+    return PlcOpenEx(ipAddress, port, nullptr);
+}
+
+int PlcOpenEx(const char* ipAddress, int port, const PlcSocketOptions* options) {
+    if (!ipAddress) return -1;
+    PlcManager::LinkSettings link;
+    if (options) {
+        link.socket = ToSocketOptions(*options);
+    }
+    PlcSession session = GetPlcManager().open(ipAddress, port, link);
+    LogNative("PlcOpen: handle " + std::to_string(session->id) + " -> " + std::string(ipAddress) + ":" + std::to_string(port));
+    return session->id;
+}
+
+bool PlcClose(int handle) {
+    LogNative("PlcClose: handle " + std::to_string(handle));
+    if (FindPlc(handle) == DefaultPlc()) return false; // DisconnectPlc stops that one
+    return GetPlcManager().close(handle);
+}
+
+bool PlcIsConnected(int handle) {
+    PlcSession session = FindPlc(handle);
+    return session && session->connected;
+}
+
+bool PlcSetLinkTimeouts(int handle, int connectTimeoutMs, int responseTimeoutMs, int heartbeatMs) {
+    PlcSession session = FindPlc(handle);
+    if (!session || connectTimeoutMs <= 0 || responseTimeoutMs <= 0 || heartbeatMs <= 0) return false;
+    PlcManager::LinkSettings link = session->link();
+    link.socket.connectTimeoutMs = connectTimeoutMs;
+    link.socket.responseTimeoutMs = responseTimeoutMs;
+    link.heartbeatMs = heartbeatMs;
+    session->setLink(link);
+    return true;
+}
+
+void PlcDefaultSocketOptions(PlcSocketOptions* options) {
+    if (options) {
+        *options = FromSocketOptions(PlcManager::LinkSettings().socket);
+    }
+}
+
+bool PlcSetSocketOptions(int handle, const PlcSocketOptions* options) {
+    PlcSession session = FindPlc(handle);
+    if (!session || !options) return false;
+    PlcManager::LinkSettings link = session->link();
+    link.socket = ToSocketOptions(*options);
+    session->setLink(link);
+    return true;
+}
+
+int PlcReadWords(int handle, const char* headdevice, int count, short* values) {
+    std::shared_ptr<MCProtocol> plc = ConnectedPlc(handle);
+    if (!plc || !headdevice || !values || count <= 0) return -1;
+    try {
+        std::vector<int16_t> words = plc->read_sign_word(headdevice, count);
+        std::copy(words.begin(), words.end(), values);
+        return static_cast<int>(words.size());
+    }
+    catch (const std::exception& ex) {
+        LogNative(std::string("PlcReadWords failed: ") + ex.what());
+        return -1;
+    }
+}
+
+bool PlcWriteWords(int handle, const char* headdevice, const short* values, int count) {
+    std::shared_ptr<MCProtocol> plc = ConnectedPlc(handle);
+    if (!plc || !headdevice || !values || count <= 0) return false;
+    try {
+        plc->write_sign_word(headdevice, std::vector<int16_t>(values, values + count));
+        return true;
+    }
+    catch (const std::exception& ex) {
+        LogNative(std::string("PlcWriteWords failed: ") + ex.what());
+        return false;
+    }
+}
+
+bool PlcWriteBit(int handle, const char* device, int value) {
+    std::shared_ptr<MCProtocol> plc = ConnectedPlc(handle);
+    if (!plc || !device) return false;
+    try {
+        plc->write_bit(device, { value });
+        return true;
+    }
+    catch (const std::exception& ex) {
+        LogNative(std::string("PlcWriteBit failed: ") + ex.what());
+        return false;
+    }
+}
+
+bool PlcWriteBits(int handle, const char* const* devices, const int* values, int count) {
+    std::shared_ptr<MCProtocol> plc = ConnectedPlc(handle);
+    if (!plc || !devices || !values || count <= 0) return false;
+    try {
+        std::vector<MCProtocol::DeviceAddress> addresses;
+        addresses.reserve(count);
+        for (int i = 0; i < count; ++i) {
+            if (!devices[i]) return false;
+            addresses.emplace_back(devices[i]);
+        }
+        plc->write_random_bits(addresses, std::vector<int>(values, values + count));
+        return true;
+    }
+    catch (const std::exception& ex) {
+        LogNative(std::string("PlcWriteBits failed: ") + ex.what());
+        return false;
+    }
+}
+
+int PlcAddPollTag(int handle, const char* headdevice, int points, int periodMs) {
+    PlcSession session = FindPlc(handle);
+    if (!session || !headdevice) return -1;
+    try {
+        int slot = session->scheduler.addTag(headdevice, points, periodMs);
+        if (slot < 0) {
+            LogNative("AddPlcPollTag: tag image full, cannot add " + std::string(headdevice));
+        }
+        return slot;
+    }
+    catch (const std::exception& ex) {
+        LogNative(std::string("AddPlcPollTag failed: ") + ex.what());
+        return -1;
+    }
+}
+
+bool PlcRemovePollTag(int handle, int tagId) {
+    PlcSession session = FindPlc(handle);
+    return session && session->scheduler.removeTag(tagId);
+}
+
+int PlcGetSnapshot(int handle, int* buffer, int len) {
+    PlcSession session = FindPlc(handle);
+    if (!session || !buffer || len < 0) return 0;
+    return session->image.snapshot(reinterpret_cast<int32_t*>(buffer), len);
+}
+
+bool PlcWatchTag(int handle, int tagId, int deadband) {
+    PlcSession session = FindPlc(handle);
+    return session && session->scheduler.watch(tagId, deadband);
+}
+
+bool PlcRegisterChangeCallback(int handle, PlcChangeCallback callback) {
+    PlcSession session = FindPlc(handle);
+    if (!session) return false;
+    SetChangeCallback(*session, callback);
+    return true;
 }
 
 bool GetIsCameraConnected() {
@@ -469,6 +994,61 @@ int GetCameraExposureAuto() {
     return (int)stEnumValue.nCurValue;
 }
 
+int SetCameraTriggerMode(int mode, int line) {
+    std::lock_guard<std::mutex> lock(g_CamMutex);
+    if (!g_CamHandle) return -1;
+    if (mode < g_TriggerFreeRun || mode > g_TriggerLine || line < 0 || line > 3) return -1;
+
+    int nRet = MV_OK;
+    if (mode == g_TriggerFreeRun) {
+        nRet = MV_CC_SetEnumValue(g_CamHandle, "TriggerMode", MV_TRIGGER_MODE_OFF);
+    }
+    else {
+        unsigned int source = mode == g_TriggerSoftware
+            ? MV_TRIGGER_SOURCE_SOFTWARE
+            : static_cast<unsigned int>(MV_TRIGGER_SOURCE_LINE0 + line);
+        nRet = MV_CC_SetEnumValue(g_CamHandle, "TriggerSource", source);
+        if (nRet == MV_OK && mode == g_TriggerLine) {
+            nRet = MV_CC_SetEnumValue(g_CamHandle, "TriggerActivation", 0); // RisingEdge
+        }
+        if (nRet == MV_OK) {
+            nRet = MV_CC_SetEnumValue(g_CamHandle, "TriggerMode", MV_TRIGGER_MODE_ON);
+        }
+    }
+    if (nRet != MV_OK) {
+        LogNative("SetTriggerMode failed: " + std::to_string(nRet));
+        return nRet;
+    }
+    g_CamTriggerMode = mode;
+    LogNative("Trigger mode " + std::to_string(mode) + (mode == g_TriggerLine ? " on Line" + std::to_string(line) : ""));
+    return nRet;
+}
+
+int GetCameraTriggerMode() {
+    std::lock_guard<std::mutex> lock(g_CamMutex);
+    if (!g_CamHandle) return -1;
+    return g_CamTriggerMode;
+}
+
+bool SetCameraAcquisitionMode(int mode) {
+    if (mode != g_AcquirePolling && mode != g_AcquireCallback) return false;
+    g_CamAcquisitionMode = mode;
+    return true;
+}
+
+int GetCameraAcquisitionMode() {
+    return g_CamAcquisitionMode;
+}
+
+bool GetCameraFrameStats(CameraFrameStats* stats) {
+    if (!stats) return false;
+    stats->received = g_FrameCounters.received.load(std::memory_order_relaxed);
+    stats->delivered = g_FrameCounters.delivered.load(std::memory_order_relaxed);
+    stats->dropped = g_FrameCounters.dropped.load(std::memory_order_relaxed);
+    stats->lost = g_FrameCounters.lost.load(std::memory_order_relaxed);
+    return true;
+}
+
 float GetCameraExposureTime() {
     std::lock_guard<std::mutex> lock(g_CamMutex);
     if (!g_CamHandle) return -1.0f;
@@ -483,33 +1063,230 @@ float GetCameraExposureTime() {
 }
 
 void SetPlcBit(const char* device, int value) {
-    if (g_IsConnected) {
-        std::lock_guard<std::mutex> lock(g_PlcMutex);
-        if (g_Plc && g_Plc->isConnected()) {
+    std::shared_ptr<MCProtocol> plc = ConnectedPlc(0);
+    if (plc) {
+        try {
+            plc->write_bit(device, { value });
+        } catch (...) {}
+    }
+}
+
+bool SetPlcBits(const char* const* devices, const int* values, int count) {
+    return PlcWriteBits(0, devices, values, count);
+}
+
+int RunMultiLightScan(const MultiLightScanConfig* config, MultiLightScanCallback callback) {
+    if (!config || config->stepCount <= 0 || config->stepCount > g_ScanMaxSteps ||
+        config->lightCount <= 0 || config->lightCount > g_ScanMaxLights ||
+        !config->lightMasks || !config->fileNames || !config->lightDevices) {
+        LogNative("RunMultiLightScan: invalid config");
+        return -1;
+    }
+    std::shared_ptr<MCProtocol> plc = ConnectedPlc(0);
+    if (!plc || !g_CamLiveViewRunning) {
+        LogNative("RunMultiLightScan: PLC or camera not ready");
+        return -1;
+    }
+    std::unique_lock<std::mutex> scanLock(g_ScanMutex, std::try_to_lock);
+    if (!scanLock) {
+        LogNative("RunMultiLightScan: a scan is already running");
+        return -1;
+    }
+
+    std::vector<MCProtocol::DeviceAddress> lights;
+    std::vector<MCProtocol::DeviceAddress> trigger;
+    try {
+        for (int i = 0; i < config->lightCount; ++i) {
+            if (!config->lightDevices[i]) throw std::invalid_argument("missing light device");
+            lights.emplace_back(config->lightDevices[i]);
+        }
+        if (config->triggerDevice && *config->triggerDevice) {
+            trigger.emplace_back(config->triggerDevice);
+        }
+    }
+    catch (const std::exception& ex) {
+        LogNative(std::string("RunMultiLightScan: ") + ex.what());
+        return -1;
+    }
+    auto setLights = [&](int mask) {
+        std::vector<int> values(lights.size());
+        for (size_t i = 0; i < values.size(); ++i) {
+            values[i] = (mask >> i) & 1;
+        }
+        plc->write_random_bits(lights, values);
+    };
+
+    int64_t exposureMs = 0;
+    {
+        std::lock_guard<std::mutex> lock(g_CamMutex);
+        MVCC_FLOATVALUE stExposure = {0};
+        if (g_CamHandle && MV_CC_GetFloatValue(g_CamHandle, "ExposureTime", &stExposure) == MV_OK) {
+            exposureMs = static_cast<int64_t>(stExposure.fCurValue / 1000.0f) + 1;
+        }
+    }
+    int settleMs = std::max(config->settleMs, 0);
+    int timeoutMs = config->frameTimeoutMs > 0 ? config->frameTimeoutMs : g_ScanFrameTimeoutMs;
+    int triggerMode = g_CamTriggerMode;
+    LogNative("RunMultiLightScan: " + std::to_string(config->stepCount) + " steps, settle " +
+        std::to_string(settleMs) + " ms, exposure " + std::to_string(exposureMs) + " ms, trigger " +
+        std::to_string(triggerMode));
+
+    // Triggered: expose once per step after the settle time. A line trigger is pulsed
+    // through the PLC output wired to it; the reset is queued behind the set, not awaited.
+    std::function<bool()> fire;
+    if (triggerMode == g_TriggerSoftware) {
+        fire = FireSoftwareTrigger;
+    }
+    else if (triggerMode == g_TriggerLine && !trigger.empty()) {
+        fire = [&]() {
             try {
-                g_Plc->write_bit(device, { value });
-            } catch (...) {}
+                plc->write_random_bits(trigger, { 1 });
+                plc->async_write_bit(trigger[0], { 0 }, [](bool, std::exception_ptr) {});
+                return true;
+            }
+            catch (const std::exception& ex) {
+                LogNative(std::string("RunMultiLightScan: trigger pulse failed: ") + ex.what());
+                return false;
+            }
+        };
+    }
+
+    // Images are written by the writer pool while the next steps light up and expose;
+    // results are reported in step order as they come in, and all of them by the end,
+    // each under the name its file really got
+    struct PendingSave {
+        int step;
+        std::string fileName;
+        std::future<bool> result;
+    };
+    int saved = 0;
+    std::deque<PendingSave> saving;
+    auto reportSaves = [&](bool wait) {
+        while (!saving.empty()) {
+            PendingSave& pending = saving.front();
+            if (!wait && pending.result.valid() && pending.result.wait_for(std::chrono::seconds(0)) != std::future_status::ready) return;
+            bool ok = pending.result.valid() && pending.result.get();
+            if (ok) ++saved;
+            if (callback) callback(pending.step, ok ? 0 : -3, pending.fileName.c_str());
+            saving.pop_front();
+        }
+    };
+
+    for (int step = 0; step < config->stepCount; ++step) {
+        std::string name = config->fileNames[step] ? config->fileNames[step] : "";
+        try {
+            setLights(config->lightMasks[step]);
+        }
+        catch (const std::exception& ex) {
+            LogNative(std::string("RunMultiLightScan: light switch failed: ") + ex.what());
+            reportSaves(true);
+            if (callback) callback(step, -1, name.c_str());
+            break; // lights are in an unknown state, the remaining images would be wrong
+        }
+        // The PLC acknowledges the write once its outputs are set
+        int64_t notBeforeMs = HostNowMs() + settleMs;
+        if (triggerMode != g_TriggerFreeRun) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(settleMs));
+            notBeforeMs = HostNowMs();
+        }
+
+        FrameLease frame = WaitScanFrame(notBeforeMs, exposureMs, fire, timeoutMs);
+        reportSaves(false);
+        if (!frame) {
+            LogNative("RunMultiLightScan: no frame for step " + std::to_string(step));
+            if (callback) callback(step, -2, name.c_str());
+            continue;
         }
+        PendingSave pending{ step };
+        pending.result = QueueSave(std::move(frame), name, pending.fileName);
+        saving.push_back(std::move(pending));
+    }
+    reportSaves(true);
+
+    try {
+        setLights(0);
+    }
+    catch (const std::exception& ex) {
+        LogNative(std::string("RunMultiLightScan: lights off failed: ") + ex.what());
     }
+    LogNative("RunMultiLightScan: saved " + std::to_string(saved) + "/" + std::to_string(config->stepCount));
+    return saved;
 }
 
 bool CaptureImageCustom(const char* filename) {
-    if (!g_CamLiveViewRunning) return false;
+    return CaptureImageCustomEx(filename, false);
+}
+
+bool CaptureImageCustomEx(const char* filename, bool waitForWrite) {
+    if (!g_CamLiveViewRunning || !filename) return false;
 
     {
         std::lock_guard<std::mutex> lock(g_CaptureMutex);
-        g_CaptureFilename = filename;
+        g_CaptureFrame = nullptr;
         g_CaptureFinished = false;
         g_CaptureRequest = true;
     }
+    if (g_CamTriggerMode == g_TriggerSoftware && !FireSoftwareTrigger()) {
+        std::lock_guard<std::mutex> lock(g_CaptureMutex);
+        g_CaptureRequest = false;
+        g_CaptureFrame = nullptr;
+        return false;
+    }
 
-    // Wait for completion (timeout 5s)
+    // Wait for the frame (timeout 5s)
+    FrameLease frame;
     {
         std::unique_lock<std::mutex> lock(g_CaptureMutex);
-        if (g_CaptureCV.wait_for(lock, std::chrono::seconds(5), []{ return g_CaptureFinished; })) {
-             return true;
+        if (!g_CaptureCV.wait_for(lock, std::chrono::seconds(5), []{ return g_CaptureFinished; })) {
+            g_CaptureRequest = false;
+            return false; // Timeout
         }
+        frame = std::move(g_CaptureFrame);
+    }
+    if (!frame) return false; // a capture running alongside took the frame
+
+    // Queued from this thread: with the Block overflow policy a full queue waits here
+    std::string fileName;
+    std::future<bool> write = QueueSave(std::move(frame), filename, fileName, waitForWrite);
+    if (!write.valid()) return false; // writer queue full
+    return !waitForWrite || write.get();
+}
+
+bool SetImageWriterOptions(int threads, int queueDepth, int overflow) {
+    if (threads < 1 || threads > g_WriterMaxThreads || queueDepth < 1 || queueDepth > g_WriterMaxQueueDepth ||
+        overflow < 0 || overflow > static_cast<int>(ImageWriterPool::Overflow::DropOldest)) {
+        return false;
+    }
+    auto replacement = std::make_shared<ImageWriterPool>(threads, queueDepth,
+        static_cast<ImageWriterPool::Overflow>(overflow), std::chrono::milliseconds(g_WriterBlockTimeoutMs));
+    {
+        std::lock_guard<std::mutex> lock(g_WriterMutex);
+        ImageWriterSlot().swap(replacement);
     }
-    return false; // Timeout
+    // The old pool writes out its queue as the last user lets go of it
+    replacement.reset();
+    LogNative("Image writers: " + std::to_string(threads) + " threads, queue " + std::to_string(queueDepth) +
+        ", overflow " + std::to_string(overflow));
+    return true;
+}
+
+bool WaitImageWrites(int timeoutMs) {
+    return GetImageWriter()->waitIdle(std::chrono::milliseconds(std::max(timeoutMs, 0)));
+}
+
+int GetImageWritesPending() {
+    return static_cast<int>(GetImageWriter()->pending());
+}
+
+bool SetImageFormat(int format, int jpegQuality) {
+    if (format < MV_Image_Undefined || format > MV_Image_Tif ||
+        jpegQuality < static_cast<int>(g_JpegQualityMin) || jpegQuality > static_cast<int>(g_JpegQualityMax)) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(g_ImageEncodingMutex);
+    g_ImageEncoding.type = static_cast<MV_SAVE_IAMGE_TYPE>(format);
+    g_ImageEncoding.jpegQuality = static_cast<unsigned int>(jpegQuality);
+    LogNative("Image format " + std::to_string(format) + ", JPEG quality " + std::to_string(jpegQuality));
+    return true;
 }
 
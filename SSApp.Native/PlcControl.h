@@ -22,12 +22,78 @@ extern "C" {
 
     SSAPPNATIVE_API bool ConnectPlc(const char* ipAddress, int port);
 
+    // Socket tuning for a PLC connection; times in milliseconds. Start from
+    // PlcDefaultSocketOptions and change what you need. Applies from the next (re)connect.
+    struct PlcSocketOptions {
+        int noDelay;             // 1 = send each frame at once (TCP_NODELAY, default)
+        int keepAlive;           // 1 = TCP keepalive probes (default)
+        int keepAliveIdleMs;     // silence before the first probe (whole seconds off Windows, rounded up)
+        int keepAliveIntervalMs; // between probes (likewise)
+        int sendBufferBytes;     // 0 = OS default
+        int receiveBufferBytes;  // 0 = OS default
+        int connectTimeoutMs;
+        int responseTimeoutMs;   // a request unanswered this long drops the connection
+        int transport;           // 0 = TCP (default), 1 = UDP (4E frames; TCP-only fields ignored)
+        int udpRetries;          // UDP: resends of an unanswered request before giving up (0-10)
+        int keepAliveProbes;     // unanswered probes before the connection is dropped (1-127)
+    };
+    SSAPPNATIVE_API void PlcDefaultSocketOptions(PlcSocketOptions* options);
+    SSAPPNATIVE_API bool ConnectPlcEx(const char* ipAddress, int port, const PlcSocketOptions* options); // nullptr = keep current
+
     SSAPPNATIVE_API void DisconnectPlc();
 
     SSAPPNATIVE_API int GetLastPlcValue(); // Returns value of D0
 
+    // Copies up to len polled values (one consistent poll, slot 0 = D0) into buffer without
+    // touching the PLC; returns how many tags the image holds, which may exceed len
+    SSAPPNATIVE_API int GetPlcSnapshot(int* buffer, int len);
+
+    // Poll scheduler: read 'points' devices from headdevice every periodMs (10-10000) into
+    // the snapshot image, one signed word or 0/1 bit per slot. Returns the tag id, which is
+    // also its first slot, or -1. D0 @ 500 ms is registered in slot 0 by default.
+    SSAPPNATIVE_API int AddPlcPollTag(const char* headdevice, int points, int periodMs);
+    SSAPPNATIVE_API bool RemovePlcPollTag(int tagId);
+    SSAPPNATIVE_API void ClearPlcPollTags();
+
+    // Change notification for watched poll tags. All changes from one poll cycle arrive in
+    // one call on the PLC poller thread; copy what you need and return quickly.
+    struct PlcTagChange {
+        int tagId;
+        int slot;
+        int value;
+        int previous;
+    };
+    typedef void (*PlcChangeCallback)(const PlcTagChange* changes, int count);
+
+    SSAPPNATIVE_API void RegisterPlcChangeCallback(PlcChangeCallback callback); // nullptr to stop
+    // deadband: minimum move of a word value before it is reported again (0 = any change);
+    // bit tags report every edge. The first poll after watching reports current values.
+    SSAPPNATIVE_API bool WatchPlcTag(int tagId, int deadband);
+    SSAPPNATIVE_API bool UnwatchPlcTag(int tagId);
+
     SSAPPNATIVE_API bool GetIsConnected(); // Returns true if connected
 
+    // Multi-PLC: each handle is an independent connection (kept alive and reconnected in
+    // the background) with its own poll tags and snapshot image. The single-PLC functions
+    // above drive one built-in connection of the same kind, which is handle 0.
+    SSAPPNATIVE_API int PlcOpen(const char* ipAddress, int port); // Returns a handle > 0, or -1
+    SSAPPNATIVE_API int PlcOpenEx(const char* ipAddress, int port, const PlcSocketOptions* options);
+    SSAPPNATIVE_API bool PlcSetSocketOptions(int handle, const PlcSocketOptions* options);
+    SSAPPNATIVE_API bool PlcClose(int handle);
+    SSAPPNATIVE_API bool PlcIsConnected(int handle);
+    // Defaults 1500 / 1000 / 500 ms. A silent link is probed every heartbeatMs and dropped
+    // after responseTimeoutMs without a reply; applies from the next (re)connect.
+    SSAPPNATIVE_API bool PlcSetLinkTimeouts(int handle, int connectTimeoutMs, int responseTimeoutMs, int heartbeatMs);
+    SSAPPNATIVE_API int PlcReadWords(int handle, const char* headdevice, int count, short* values); // Returns count read, or -1
+    SSAPPNATIVE_API bool PlcWriteWords(int handle, const char* headdevice, const short* values, int count);
+    SSAPPNATIVE_API bool PlcWriteBit(int handle, const char* device, int value);
+    SSAPPNATIVE_API bool PlcWriteBits(int handle, const char* const* devices, const int* values, int count);
+    SSAPPNATIVE_API int PlcAddPollTag(int handle, const char* headdevice, int points, int periodMs);
+    SSAPPNATIVE_API bool PlcRemovePollTag(int handle, int tagId);
+    SSAPPNATIVE_API int PlcGetSnapshot(int handle, int* buffer, int len);
+    SSAPPNATIVE_API bool PlcWatchTag(int handle, int tagId, int deadband);
+    SSAPPNATIVE_API bool PlcRegisterChangeCallback(int handle, PlcChangeCallback callback);
+
     SSAPPNATIVE_API bool GetIsCameraConnected(); // Returns true if camera is connected
 
     // Camera Exposure Controls
@@ -36,7 +102,79 @@ extern "C" {
     SSAPPNATIVE_API int GetCameraExposureAuto(); // Get current auto mode
     SSAPPNATIVE_API float GetCameraExposureTime(); // Get current time
 
+    // Camera trigger: 0 = free run (live view default), 1 = software (each capture fires
+    // TriggerSoftware), 2 = rising edge on input Line<line> (0-3). In the trigger modes each
+    // captured frame is exactly one exposure started after the request. Returns 0 or an
+    // SDK error code, -1 if no camera. StartLiveView resets to free run.
+    SSAPPNATIVE_API int SetCameraTriggerMode(int mode, int line);
+    SSAPPNATIVE_API int GetCameraTriggerMode(); // -1 if no camera
+
+    // Frame acquisition for the next StartLiveView: 0 = polling thread, 1 = SDK image
+    // callback (default) queueing frames for a dispatch thread. False for other modes.
+    SSAPPNATIVE_API bool SetCameraAcquisitionMode(int mode);
+    SSAPPNATIVE_API int GetCameraAcquisitionMode();
+
+    // Frame counts since StartLiveView
+    struct CameraFrameStats {
+        unsigned long long received;  // frames the SDK handed over
+        unsigned long long delivered; // frames displayed and offered to capture / scans
+        unsigned long long dropped;   // let go because the dispatch queue was full
+        unsigned long long lost;      // gaps in the camera's frame numbers, never received
+    };
+    SSAPPNATIVE_API bool GetCameraFrameStats(CameraFrameStats* stats);
+
     // New Control Functions
     SSAPPNATIVE_API void SetPlcBit(const char* device, int value);
+    // Sets count bit devices (values 0/1, up to 188) in one request, so they all switch in
+    // the same PLC scan; one round trip instead of count
+    SSAPPNATIVE_API bool SetPlcBits(const char* const* devices, const int* values, int count);
+    // Captures the next frame to images/<filename> through the image writer pool. Returns
+    // once the frame is queued (false if the queue turned it away or no frame came in 5 s).
+    // The extension may be changed to match the format (SetImageFormat); "" = img_<ms>.
     SSAPPNATIVE_API bool CaptureImageCustom(const char* filename);
+    // Same; with waitForWrite it returns once the file is written and flushed to disk,
+    // false if that failed
+    SSAPPNATIVE_API bool CaptureImageCustomEx(const char* filename, bool waitForWrite);
+
+    // Image writer pool for captures and scan images: 'threads' writers (1-8, default 2)
+    // and up to 'queueDepth' queued images (1-64, default 4), each holding its camera
+    // buffer until written. When the queue is full, overflow 0 = the caller waits for room
+    // (up to 5 s, default), 1 = the new image is rejected, 2 = the oldest queued image is
+    // dropped. Images already queued are still written.
+    SSAPPNATIVE_API bool SetImageWriterOptions(int threads, int queueDepth, int overflow);
+    SSAPPNATIVE_API bool WaitImageWrites(int timeoutMs); // false if still writing at the timeout
+    SSAPPNATIVE_API int GetImageWritesPending(); // queued + being written
+
+    // File format of captures and scan images: 0 = by the file name's extension (default;
+    // .jpg/.jpeg, .png, .tif/.tiff, .bmp; none or any other is replaced by .bmp), 1 = BMP,
+    // 2 = JPEG, 3 = PNG, 4 = TIFF. A set format also gives the file its extension.
+    // jpegQuality 51-99 (default 90). TIFF from Mono10/12/16 frames is 16-bit grayscale
+    // with the camera's values. Applies to images queued from then on.
+    SSAPPNATIVE_API bool SetImageFormat(int format, int jpegQuality);
+
+    // Multi-light scan run natively on the connected PLC and live camera. Each step
+    // switches all lights in one PLC write, waits settleMs, takes the first frame whose
+    // exposure started after that (by frame timestamps) and saves it to images/<fileName>
+    // while the next step is already lighting up. With a camera trigger mode set, each
+    // step instead fires one exposure once the lights have settled.
+    struct MultiLightScanConfig {
+        int stepCount;                   // up to 32
+        const int* lightMasks;           // per step: bit i switches lightDevices[i]
+        const char* const* fileNames;    // per step
+        int lightCount;                  // up to 16
+        const char* const* lightDevices; // bit devices, e.g. Y1
+        int settleMs;                    // light rise time before an exposure counts
+        int frameTimeoutMs;              // per step; 0 = 2000
+        const char* triggerDevice;       // line trigger: PLC output wired to the camera line,
+                                         // pulsed once per step (nullptr = triggered elsewhere)
+    };
+    // status: 0 = saved, -1 = light switch failed (scan stops), -2 = no frame in time,
+    // -3 = save failed. Called in step order on the thread running the scan. fileName is
+    // the image's name under images/, whose extension may differ from the configured one
+    // (SetImageFormat); with -1/-2 it is the configured name.
+    typedef void (*MultiLightScanCallback)(int step, int status, const char* fileName);
+
+    // Blocks until done and turns all lights off. Returns images saved, or -1 if the scan
+    // could not start (bad config, PLC or camera down, another scan running).
+    SSAPPNATIVE_API int RunMultiLightScan(const MultiLightScanConfig* config, MultiLightScanCallback callback);
 }
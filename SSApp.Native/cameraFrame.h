@@ -0,0 +1,77 @@
+#ifndef CAMERAFRAME_H
+#define CAMERAFRAME_H
+
+#include <atomic>
+#include <memory>
+#include <cstring>
+
+#include "MvCameraControl.h"
+
+// One grabbed frame, used in place in the SDK's own buffer (MV_CC_GetImageBuffer) instead
+// of being copied out. Display, capture and the scan share it through FrameLease; the
+// buffer goes back to the SDK (MV_CC_FreeImageBuffer) when the last lease is dropped.
+// The SDK hands out at most its image node count of buffers at once, so a lease held for
+// long (a save in flight) keeps one node busy; the camera must outlive every lease.
+class CameraFrame {
+public:
+    CameraFrame(void* camHandle, const MV_FRAME_OUT& out) : handle(camHandle), frame(out) {
+        leasedCount().fetch_add(1, std::memory_order_relaxed);
+    }
+
+    ~CameraFrame() {
+        MV_CC_FreeImageBuffer(handle, &frame);
+        leasedCount().fetch_sub(1, std::memory_order_release);
+    }
+
+    CameraFrame(const CameraFrame&) = delete;
+    CameraFrame& operator=(const CameraFrame&) = delete;
+
+    unsigned char* data() const {
+        return frame.pBufAddr;
+    }
+
+    unsigned int size() const {
+        return frame.stFrameInfo.nFrameLen;
+    }
+
+    const MV_FRAME_OUT_INFO_EX& info() const {
+        return frame.stFrameInfo;
+    }
+
+    // Handle of the camera the frame came from, for SDK calls on it (saving)
+    void* camera() const {
+        return handle;
+    }
+
+    // Frames not yet given back to the SDK, across all cameras
+    static int leased() {
+        return leasedCount().load(std::memory_order_acquire);
+    }
+
+private:
+    void* const handle;
+    MV_FRAME_OUT frame;
+
+    static std::atomic<int>& leasedCount() {
+        static std::atomic<int> count{ 0 };
+        return count;
+    }
+};
+
+using FrameLease = std::shared_ptr<const CameraFrame>;
+
+// Next frame from a grabbing camera, or nullptr on timeout / error (code in *error)
+inline FrameLease AcquireFrame(void* camHandle, unsigned int timeoutMs, int* error = nullptr) {
+    MV_FRAME_OUT out;
+    std::memset(&out, 0, sizeof(out));
+    int nRet = MV_CC_GetImageBuffer(camHandle, &out, timeoutMs);
+    if (error) {
+        *error = nRet;
+    }
+    if (nRet != MV_OK || !out.pBufAddr) {
+        return nullptr;
+    }
+    return std::make_shared<const CameraFrame>(camHandle, out);
+}
+
+#endif // CAMERAFRAME_H
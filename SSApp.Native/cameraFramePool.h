@@ -0,0 +1,101 @@
+#ifndef CAMERAFRAMEPOOL_H
+#define CAMERAFRAMEPOOL_H
+
+#include <vector>
+#include <cstdint>
+
+#include "MvCameraControl.h"
+
+// Frame buffers sized from the camera's PayloadSize and allocated once per live view with
+// MV_CC_AllocAlignedBuffer, so any sensor fits and no frame ever allocates.
+//
+// registerWith() hands them to the SDK (MV_CC_RegisterBuffer) as its grab nodes. From then
+// on the SDK's own node queue is the free list: MV_CC_GetImageBuffer returns a frame in
+// one of them and MV_CC_FreeImageBuffer requeues it, so the pool itself only owns the
+// memory. The buffers come back on unregisterFrom(), after StopGrabbing.
+class FramePool {
+public:
+    FramePool() = default;
+
+    FramePool(const FramePool&) = delete;
+    FramePool& operator=(const FramePool&) = delete;
+
+    ~FramePool() {
+        freeAll();
+    }
+
+    // Makes 'count' buffers of at least 'size' bytes. Existing buffers are kept when they
+    // fit; nothing is reallocated while the SDK holds them (returns false).
+    bool reserve(uint64_t size, unsigned int alignment, int count) {
+        if (size == 0 || count <= 0 || registered > 0) {
+            return false;
+        }
+        if (size <= buffer_size && count == static_cast<int>(buffers.size())) {
+            return true;
+        }
+        freeAll();
+
+        buffers.reserve(count);
+        for (int i = 0; i < count; ++i) {
+            void* buffer = MV_CC_AllocAlignedBuffer(size, alignment);
+            if (!buffer) {
+                freeAll();
+                return false;
+            }
+            buffers.push_back(static_cast<uint8_t*>(buffer));
+        }
+        buffer_size = size;
+        return true;
+    }
+
+    // Gives up to 'count' buffers to the SDK as grab nodes; returns how many took
+    int registerWith(void* camHandle, int count) {
+        while (registered < count && registered < static_cast<int>(buffers.size())) {
+            if (MV_CC_RegisterBuffer(camHandle, buffers[registered], buffer_size, nullptr) != MV_OK) {
+                break;
+            }
+            ++registered;
+        }
+        return registered;
+    }
+
+    // After StopGrabbing: takes the grab nodes back from the SDK
+    void unregisterFrom(void* camHandle) {
+        for (int i = 0; i < registered; ++i) {
+            MV_CC_UnRegisterBuffer(camHandle, buffers[i]);
+        }
+        registered = 0;
+    }
+
+    // For a camera handle that is never closed (frames still leased at StopLiveView): its
+    // grab nodes stay with the SDK, so forget them unfreed and allocate afresh next time
+    void abandon() {
+        buffers.clear();
+        registered = 0;
+        buffer_size = 0;
+    }
+
+    uint64_t bufferSize() const {
+        return buffer_size;
+    }
+
+    int capacity() const {
+        return static_cast<int>(buffers.size());
+    }
+
+private:
+    std::vector<uint8_t*> buffers;
+    int registered = 0; // buffers[0, registered) are the SDK's grab nodes
+    uint64_t buffer_size = 0;
+
+    void freeAll() {
+        for (uint8_t* buffer : buffers) {
+            MV_CC_FreeAlignedBuffer(buffer);
+        }
+        buffers.clear();
+        registered = 0;
+        buffer_size = 0;
+    }
+};
+
+#endif // CAMERAFRAMEPOOL_H
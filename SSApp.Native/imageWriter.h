@@ -0,0 +1,146 @@
+#ifndef IMAGEWRITER_H
+#define IMAGEWRITER_H
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Image saves queued for a few writer threads, so no frame thread ever waits on the disk.
+// The queue is bounded; when it is full the overflow policy decides: Block makes the
+// submitter wait for room (up to blockTimeout, then it is rejected), Reject turns the new
+// job away, DropOldest discards the longest-waiting job. Each job's result comes back
+// through its future: false when it failed or was dropped. The destructor writes out
+// whatever is still queued before joining the writers.
+class ImageWriterPool {
+public:
+    enum class Overflow { Block, Reject, DropOldest };
+    using Job = std::function<bool()>;
+
+    ImageWriterPool(int threads, size_t depth, Overflow policy, std::chrono::milliseconds blockTimeout)
+        : limit(depth > 0 ? depth : 1), overflow(policy), block_timeout(blockTimeout) {
+        for (int i = 0; i < (threads > 0 ? threads : 1); ++i) {
+            writers.emplace_back([this] { run(); });
+        }
+    }
+
+    ~ImageWriterPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        work_ready.notify_all();
+        room.notify_all();
+        for (std::thread& writer : writers) {
+            writer.join();
+        }
+    }
+
+    ImageWriterPool(const ImageWriterPool&) = delete;
+    ImageWriterPool& operator=(const ImageWriterPool&) = delete;
+
+    // The job's result, or an invalid future when it was not queued
+    std::future<bool> submit(Job job) {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (queue.size() >= limit) {
+            if (overflow == Overflow::DropOldest) {
+                queue.front().result.set_value(false);
+                queue.pop_front();
+                ++dropped_count;
+            }
+            else if (overflow == Overflow::Reject
+                || !room.wait_for(lock, block_timeout, [this] { return stopping || queue.size() < limit; })) {
+                ++rejected_count;
+                return {};
+            }
+        }
+        if (stopping) {
+            return {};
+        }
+        queue.push_back({ std::move(job), std::promise<bool>() });
+        std::future<bool> result = queue.back().result.get_future();
+        lock.unlock();
+        work_ready.notify_one();
+        return result;
+    }
+
+    // Waits until every queued job is done; false on timeout
+    bool waitIdle(std::chrono::milliseconds timeout) {
+        std::unique_lock<std::mutex> lock(mutex);
+        return idle.wait_for(lock, timeout, [this] { return queue.empty() && running == 0; });
+    }
+
+    // Jobs queued or being written
+    size_t pending() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return queue.size() + running;
+    }
+
+    uint64_t rejected() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return rejected_count;
+    }
+
+    uint64_t dropped() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return dropped_count;
+    }
+
+private:
+    struct Entry {
+        Job job;
+        std::promise<bool> result;
+    };
+
+    const size_t limit;
+    const Overflow overflow;
+    const std::chrono::milliseconds block_timeout;
+
+    mutable std::mutex mutex;
+    std::condition_variable work_ready;
+    std::condition_variable room;
+    std::condition_variable idle;
+    std::deque<Entry> queue;
+    size_t running = 0;
+    bool stopping = false;
+    uint64_t rejected_count = 0;
+    uint64_t dropped_count = 0;
+    std::vector<std::thread> writers;
+
+    void run() {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true) {
+            work_ready.wait(lock, [this] { return stopping || !queue.empty(); });
+            if (queue.empty()) {
+                return; // stopping, and everything is written
+            }
+            Entry entry = std::move(queue.front());
+            queue.pop_front();
+            ++running;
+            lock.unlock();
+            room.notify_one();
+
+            bool ok = false;
+            try {
+                ok = entry.job();
+            }
+            catch (...) {
+            }
+            entry.job = nullptr; // let go of what the job holds (its frame) before reporting
+            entry.result.set_value(ok);
+
+            lock.lock();
+            --running;
+            if (queue.empty() && running == 0) {
+                idle.notify_all();
+            }
+        }
+    }
+};
+
+#endif // IMAGEWRITER_H
@@ -0,0 +1,556 @@
+#ifndef MCEVENTLOOP_H
+#define MCEVENTLOOP_H
+
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <map>
+#include <memory>
+#include <functional>
+#include <algorithm>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <stdexcept>
+#include <exception>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#pragma comment(lib, "Ws2_32.lib")
+#else
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#define INVALID_SOCKET -1
+#define SOCKET_ERROR -1
+#define SOCKET int
+#define closesocket close
+#endif
+
+// Single-threaded I/O loop for MC protocol connections.
+// Sockets handed over with attach() become non-blocking and are owned by the loop thread:
+// requests are queued with submit(), written when the socket is writable, and completed
+// from the loop thread once their reply frame has been split off the stream.
+// 3E channels keep one request on the wire (replies carry no tag); 4E channels keep up to
+// 'depth' requests in flight and match replies by serial number. UDP channels are 4E with
+// one frame per datagram, and resend a request that times out instead of failing at once.
+class MCEventLoop {
+public:
+    using Completion = std::function<void(std::vector<uint8_t>& reply, std::exception_ptr error)>;
+    using Clock = std::chrono::steady_clock;
+
+    // Per-connection state. After attach() only the loop thread touches it;
+    // callers just hold the pointer as a handle.
+    struct Channel {
+        SOCKET sock = INVALID_SOCKET;
+        bool frame4E = false;
+        int depth = 1;
+        int timeoutMs = 6000;
+        bool datagram = false; // UDP
+        int retries = 0;       // UDP: resends of an unanswered request
+        std::atomic<bool> closed{ false };
+
+        struct InFlight {
+            uint16_t serial;
+            Completion done;
+            Clock::time_point deadline;
+            int retriesLeft = 0;
+            std::vector<uint8_t> frame; // UDP: kept for resending
+        };
+
+        uint16_t nextSerial = 0;
+        std::deque<std::pair<std::vector<uint8_t>, Completion>> queued; // not on the wire yet
+        std::deque<InFlight> inFlight;                                   // in send order
+        std::vector<uint8_t> tx;
+        size_t txOffset = 0;
+        std::vector<uint8_t> rx;
+    };
+
+    MCEventLoop() {
+#ifdef _WIN32
+        WSADATA wsaData;
+        if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0) {
+            throw std::runtime_error("WSAStartup failed");
+        }
+#endif
+        createWakeSocket();
+        worker = std::thread(&MCEventLoop::run, this);
+    }
+
+    // Channels still open are closed; their pending completions fail.
+    ~MCEventLoop() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake();
+        if (worker.joinable()) {
+            worker.join();
+        }
+        for (auto& ch : channels) {
+            failChannel(*ch, "Event loop stopped");
+        }
+        closesocket(wakeSock);
+#ifdef _WIN32
+        WSACleanup();
+#endif
+    }
+
+    MCEventLoop(const MCEventLoop&) = delete;
+    MCEventLoop& operator=(const MCEventLoop&) = delete;
+
+    // Take ownership of a connected socket. The loop closes it on closeChannel() or on error.
+    std::shared_ptr<Channel> attach(SOCKET sock, bool frame4E, int depth, int timeoutMs) {
+        auto ch = std::make_shared<Channel>();
+        ch->sock = sock;
+        ch->frame4E = frame4E;
+        ch->depth = frame4E ? std::max(1, depth) : 1;
+        ch->timeoutMs = timeoutMs;
+        return addChannel(ch);
+    }
+
+    // Take ownership of a connected UDP socket. Requests go out as 4E frames so replies
+    // match by serial; one unanswered after timeoutMs is sent again (same serial, so a
+    // late first reply still counts) up to 'retries' times before the channel fails.
+    // Safe only because every MC read and write is idempotent.
+    std::shared_ptr<Channel> attachDatagram(SOCKET sock, int depth, int timeoutMs, int retries) {
+        auto ch = std::make_shared<Channel>();
+        ch->sock = sock;
+        ch->frame4E = true;
+        ch->depth = std::max(1, depth);
+        ch->timeoutMs = timeoutMs;
+        ch->datagram = true;
+        ch->retries = std::max(0, retries);
+        return addChannel(ch);
+    }
+
+    // Fail everything pending on the channel and close its socket (asynchronously)
+    void closeChannel(const std::shared_ptr<Channel>& ch) {
+        post([this, ch]() {
+            failChannel(*ch, "Connection closed");
+        });
+    }
+
+    // Queue a 3E-layout request. 'done' runs on the loop thread with the reply in 3E layout
+    // (end code at 9, data at 11), or with an error if the channel fails or times out.
+    void submit(const std::shared_ptr<Channel>& ch, std::vector<uint8_t> packet, Completion done) {
+        post([this, ch, packet = std::move(packet), done = std::move(done)]() mutable {
+            if (ch->closed) {
+                complete(done, nullptr, "Connection closed");
+                return;
+            }
+            ch->queued.emplace_back(std::move(packet), std::move(done));
+            flushQueued(*ch);
+        });
+    }
+
+    // Run 'fn' on the loop thread after 'delay'
+    void schedule(std::chrono::milliseconds delay, std::function<void()> fn) {
+        Clock::time_point due = Clock::now() + delay;
+        post([this, due, fn = std::move(fn)]() mutable {
+            timers.emplace(due, std::move(fn));
+        });
+    }
+
+    void post(std::function<void()> fn) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            commands.push_back(std::move(fn));
+        }
+        wake();
+    }
+
+    bool isLoopThread() const {
+        return std::this_thread::get_id() == worker.get_id();
+    }
+
+private:
+#ifdef _WIN32
+    using PollFd = WSAPOLLFD;
+#else
+    using PollFd = pollfd;
+#endif
+
+    std::thread worker;
+    std::mutex mutex;
+    bool stopping = false;
+    std::deque<std::function<void()>> commands;
+
+    // Loop-thread only
+    std::vector<std::shared_ptr<Channel>> channels;
+    std::multimap<Clock::time_point, std::function<void()>> timers;
+
+    // Loopback UDP socket connected to itself; one datagram wakes poll()
+    SOCKET wakeSock = INVALID_SOCKET;
+
+    std::shared_ptr<Channel> addChannel(std::shared_ptr<Channel> ch) {
+        setNonBlocking(ch->sock);
+        post([this, ch]() {
+            channels.push_back(ch);
+        });
+        return ch;
+    }
+
+    void run() {
+        std::vector<PollFd> fds;
+        while (true) {
+            std::deque<std::function<void()>> batch;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (stopping) {
+                    break;
+                }
+                batch.swap(commands);
+            }
+            for (auto& fn : batch) {
+                runGuarded(fn);
+            }
+            runDueTimers();
+            expireRequests();
+            channels.erase(std::remove_if(channels.begin(), channels.end(),
+                [](const std::shared_ptr<Channel>& ch) { return ch->closed.load(); }), channels.end());
+
+            fds.clear();
+            fds.push_back(makePollFd(wakeSock, POLLIN));
+            for (auto& ch : channels) {
+                short events = POLLIN;
+                if (ch->txOffset < ch->tx.size()) {
+                    events |= POLLOUT;
+                }
+                fds.push_back(makePollFd(ch->sock, events));
+            }
+
+            int ready = pollSockets(fds.data(), fds.size(), nextTimeoutMs());
+            if (ready <= 0) {
+                continue;
+            }
+            if (fds[0].revents & POLLIN) {
+                drainWake();
+            }
+            // Only commands add channels, so indices still line up with fds here
+            for (size_t i = 0; i < channels.size(); ++i) {
+                Channel& ch = *channels[i];
+                short revents = fds[i + 1].revents;
+                if (revents & (POLLIN | POLLERR | POLLHUP)) {
+                    readChannel(ch);
+                }
+                if (!ch.closed && (revents & POLLOUT)) {
+                    writeChannel(ch);
+                }
+            }
+        }
+    }
+
+    void flushQueued(Channel& ch) {
+        while (!ch.closed && !ch.queued.empty() && static_cast<int>(ch.inFlight.size()) < ch.depth) {
+            std::vector<uint8_t> packet = std::move(ch.queued.front().first);
+            Completion done = std::move(ch.queued.front().second);
+            ch.queued.pop_front();
+
+            uint16_t serial = 0;
+            Clock::time_point deadline = Clock::now() + std::chrono::milliseconds(ch.timeoutMs);
+            if (ch.datagram) {
+                serial = ch.nextSerial++;
+                std::vector<uint8_t> frame = wrap4E(serial, packet);
+                sendDatagram(ch, frame);
+                ch.inFlight.push_back({ serial, std::move(done), deadline, ch.retries, std::move(frame) });
+                continue;
+            }
+            if (ch.frame4E) {
+                // 54 00 + serial + 00 00, then the 3E frame minus its 50 00 subheader
+                serial = ch.nextSerial++;
+                const uint8_t head[6] = { 0x54, 0x00,
+                    static_cast<uint8_t>(serial & 0xFF), static_cast<uint8_t>((serial >> 8) & 0xFF),
+                    0x00, 0x00 };
+                ch.tx.insert(ch.tx.end(), head, head + 6);
+                ch.tx.insert(ch.tx.end(), packet.begin() + 2, packet.end());
+            }
+            else {
+                ch.tx.insert(ch.tx.end(), packet.begin(), packet.end());
+            }
+            ch.inFlight.push_back({ serial, std::move(done), deadline, 0, {} });
+        }
+        writeChannel(ch);
+    }
+
+    static std::vector<uint8_t> wrap4E(uint16_t serial, const std::vector<uint8_t>& packet) {
+        std::vector<uint8_t> frame = { 0x54, 0x00,
+            static_cast<uint8_t>(serial & 0xFF), static_cast<uint8_t>((serial >> 8) & 0xFF),
+            0x00, 0x00 };
+        frame.insert(frame.end(), packet.begin() + 2, packet.end());
+        return frame;
+    }
+
+    // A datagram that cannot go out now counts as lost; the resend timer covers it
+    static void sendDatagram(Channel& ch, const std::vector<uint8_t>& frame) {
+        send(ch.sock, reinterpret_cast<const char*>(frame.data()), static_cast<int>(frame.size()), sendFlags());
+    }
+
+    void writeChannel(Channel& ch) {
+        while (!ch.closed && ch.txOffset < ch.tx.size()) {
+            int r = send(ch.sock, reinterpret_cast<const char*>(ch.tx.data() + ch.txOffset),
+                static_cast<int>(ch.tx.size() - ch.txOffset), sendFlags());
+            if (r > 0) {
+                ch.txOffset += static_cast<size_t>(r);
+                continue;
+            }
+            if (r < 0 && wouldBlock()) {
+                return;
+            }
+            failChannel(ch, "Send failed");
+            return;
+        }
+        ch.tx.clear();
+        ch.txOffset = 0;
+    }
+
+    void readChannel(Channel& ch) {
+        if (ch.datagram) {
+            readDatagrams(ch);
+            return;
+        }
+        uint8_t buf[4096];
+        while (!ch.closed) {
+            int r = recv(ch.sock, reinterpret_cast<char*>(buf), sizeof(buf), 0);
+            if (r > 0) {
+                ch.rx.insert(ch.rx.end(), buf, buf + r);
+                continue;
+            }
+            if (r < 0 && wouldBlock()) {
+                break;
+            }
+            failChannel(ch, r == 0 ? "Connection closed by PLC" : "Receive failed");
+            return;
+        }
+        extractFrames(ch);
+        flushQueued(ch);
+    }
+
+    // Each datagram holds one whole reply. Malformed, late or duplicate ones are dropped,
+    // and receive errors (an ICMP port-unreachable, say) just wait for the resend timer.
+    void readDatagrams(Channel& ch) {
+        uint8_t buf[8192];
+        while (!ch.closed) {
+            int r = recv(ch.sock, reinterpret_cast<char*>(buf), sizeof(buf), 0);
+            if (r <= 0) {
+                break;
+            }
+            ch.rx.assign(buf, buf + r);
+            extractFrames(ch);
+        }
+        ch.rx.clear();
+        flushQueued(ch);
+    }
+
+    // Split complete frames off rx using the header's data-length field
+    void extractFrames(Channel& ch) {
+        const size_t header = ch.frame4E ? 13 : 9;
+        size_t offset = 0;
+        while (!ch.closed && ch.rx.size() - offset >= header) {
+            const uint8_t* p = ch.rx.data() + offset;
+            size_t dataLen = static_cast<size_t>(p[header - 2]) | (static_cast<size_t>(p[header - 1]) << 8);
+            if (ch.rx.size() - offset < header + dataLen) {
+                break;
+            }
+
+            std::vector<uint8_t> reply;
+            auto it = ch.inFlight.begin();
+            if (ch.frame4E) {
+                // Drop serial + reserved so the reply reads like a 3E one
+                uint16_t serial = static_cast<uint16_t>(p[2]) | static_cast<uint16_t>(p[3] << 8);
+                reply.reserve(header + dataLen - 4);
+                reply.insert(reply.end(), p, p + 2);
+                reply.insert(reply.end(), p + 6, p + header + dataLen);
+                while (it != ch.inFlight.end() && it->serial != serial) {
+                    ++it;
+                }
+            }
+            else {
+                reply.assign(p, p + header + dataLen);
+            }
+            offset += header + dataLen;
+
+            if (it == ch.inFlight.end()) {
+                continue; // unsolicited or already timed out
+            }
+            Completion done = std::move(it->done);
+            ch.inFlight.erase(it);
+            complete(done, &reply, nullptr);
+        }
+        ch.rx.erase(ch.rx.begin(), ch.rx.begin() + offset);
+    }
+
+    void failChannel(Channel& ch, const char* reason) {
+        if (ch.closed.exchange(true)) {
+            return;
+        }
+        if (ch.sock != INVALID_SOCKET) {
+            closesocket(ch.sock);
+            ch.sock = INVALID_SOCKET;
+        }
+        std::deque<Channel::InFlight> inFlight;
+        inFlight.swap(ch.inFlight);
+        auto queued = std::move(ch.queued);
+        ch.queued.clear();
+        for (auto& req : inFlight) {
+            complete(req.done, nullptr, reason);
+        }
+        for (auto& req : queued) {
+            complete(req.second, nullptr, reason);
+        }
+    }
+
+    // A request that outlives its deadline leaves the stream out of sync, so the whole channel
+    // goes. Over UDP there is no stream: the request is resent until its retries run out.
+    void expireRequests() {
+        Clock::time_point now = Clock::now();
+        for (auto& ch : channels) {
+            for (auto& req : ch->inFlight) {
+                if (req.deadline > now) {
+                    continue;
+                }
+                if (ch->datagram && req.retriesLeft > 0) {
+                    --req.retriesLeft;
+                    req.deadline = now + std::chrono::milliseconds(ch->timeoutMs);
+                    sendDatagram(*ch, req.frame);
+                    continue;
+                }
+                failChannel(*ch, "PLC response timeout");
+                break;
+            }
+        }
+    }
+
+    void runDueTimers() {
+        Clock::time_point now = Clock::now();
+        while (!timers.empty() && timers.begin()->first <= now) {
+            std::function<void()> fn = std::move(timers.begin()->second);
+            timers.erase(timers.begin());
+            runGuarded(fn);
+        }
+    }
+
+    int nextTimeoutMs() const {
+        Clock::time_point now = Clock::now();
+        Clock::time_point next = now + std::chrono::seconds(1);
+        if (!timers.empty()) {
+            next = std::min(next, timers.begin()->first);
+        }
+        for (const auto& ch : channels) {
+            for (const auto& req : ch->inFlight) {
+                next = std::min(next, req.deadline);
+            }
+        }
+        auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(next - now).count();
+        return ms < 0 ? 0 : static_cast<int>(ms) + 1;
+    }
+
+    // Callbacks must not take the loop down with them
+    static void runGuarded(std::function<void()>& fn) {
+        try {
+            fn();
+        }
+        catch (...) {
+        }
+    }
+
+    static void complete(Completion& done, std::vector<uint8_t>* reply, const char* error) {
+        std::vector<uint8_t> empty;
+        try {
+            if (error) {
+                done(empty, std::make_exception_ptr(std::runtime_error(error)));
+            }
+            else {
+                done(*reply, nullptr);
+            }
+        }
+        catch (...) {
+        }
+    }
+
+    void createWakeSocket() {
+        wakeSock = socket(AF_INET, SOCK_DGRAM, 0);
+        if (wakeSock == INVALID_SOCKET) {
+            throw std::runtime_error("Event loop wake socket failed");
+        }
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        addr.sin_port = 0;
+        socklen_t len = sizeof(addr);
+        if (bind(wakeSock, (struct sockaddr*)&addr, sizeof(addr)) < 0 ||
+            getsockname(wakeSock, (struct sockaddr*)&addr, &len) < 0 ||
+            ::connect(wakeSock, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+            closesocket(wakeSock);
+            throw std::runtime_error("Event loop wake socket failed");
+        }
+        setNonBlocking(wakeSock);
+    }
+
+    void wake() {
+        const char b = 1;
+        send(wakeSock, &b, 1, 0);
+    }
+
+    void drainWake() {
+        char buf[64];
+        while (recv(wakeSock, buf, sizeof(buf), 0) > 0) {
+        }
+    }
+
+    static PollFd makePollFd(SOCKET s, short events) {
+        PollFd fd{};
+        fd.fd = s;
+        fd.events = events;
+        return fd;
+    }
+
+    static int pollSockets(PollFd* fds, size_t count, int timeoutMs) {
+#ifdef _WIN32
+        return WSAPoll(fds, static_cast<ULONG>(count), timeoutMs);
+#else
+        return ::poll(fds, static_cast<nfds_t>(count), timeoutMs);
+#endif
+    }
+
+    static void setNonBlocking(SOCKET s) {
+#ifdef _WIN32
+        u_long mode = 1;
+        ioctlsocket(s, FIONBIO, &mode);
+#else
+        int flags = fcntl(s, F_GETFL, 0);
+        fcntl(s, F_SETFL, flags | O_NONBLOCK);
+#endif
+    }
+
+    static bool wouldBlock() {
+#ifdef _WIN32
+        int err = WSAGetLastError();
+        return err == WSAEWOULDBLOCK || err == WSAEINTR;
+#else
+        return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+#endif
+    }
+
+    static int sendFlags() {
+#ifdef MSG_NOSIGNAL
+        return MSG_NOSIGNAL;
+#else
+        return 0;
+#endif
+    }
+};
+
+#endif // MCEVENTLOOP_H
@@ -7,34 +7,111 @@
 #include <string>
 #include <vector>
 #include <map>
+#include <set>
+#include <future>
 #include <cstdint>
 #include <algorithm>
 #include <stdexcept>
 #include <sstream>
 #include <iomanip>
 #include <cctype>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <functional>
+#include <string_view>
+#include <cstring>
+#include <array>
+#include <span>
+#include <bitset>
+
+#include "mcEventLoop.h" // also pulls in the platform socket headers
 
 #ifdef _WIN32
-#include <winsock2.h>
-#include <ws2tcpip.h>
-#pragma comment(lib, "Ws2_32.lib")
+#include <mstcpip.h> // SIO_KEEPALIVE_VALS
 #else
-#include <sys/socket.h>
-#include <arpa/inet.h>
-#include <unistd.h>
-#include <cstring>
-#define INVALID_SOCKET -1
-#define SOCKET_ERROR -1
-#define SOCKET int
-#define closesocket close
+#include <netinet/tcp.h>
 #endif
 
 class MCProtocol {
 public:
+    // The PLC answered with a non-zero end code: the link is fine, the request was refused
+    class PlcError : public std::runtime_error {
+    public:
+        PlcError(uint16_t code, const std::string& what) : std::runtime_error(what), endCode(code) {}
+        uint16_t endCode;
+    };
+
     enum DeviceType {
         M, L, F, D, R, B, W, X, Y
     };
 
+    enum class FrameType {
+        E3, // stop-and-wait, no serial number
+        E4  // serial-numbered, allows several requests in flight
+    };
+
+    enum class Transport {
+        TCP,
+        UDP  // always 4E frames; unanswered requests are resent (MC reads/writes are idempotent)
+    };
+
+    // Socket settings for one connection, taken at connect()/beginConnect()
+    struct SocketOptions {
+        Transport transport = Transport::TCP;
+        bool noDelay = true;           // send each frame at once; Nagle holds a write until the last one is ACKed
+        bool keepAlive = true;         // lets an idle connection notice a pulled cable
+        int keepAliveIdleMs = 2000;    // silence before the first probe (whole seconds on POSIX, rounded up)
+        int keepAliveIntervalMs = 500; // between unanswered probes (likewise)
+        int keepAliveProbes = 4;       // unanswered probes before the connection is dropped (1-127)
+        int sendBufferBytes = 0;       // 0 = OS default
+        int receiveBufferBytes = 0;
+        int connectTimeoutMs = 3000;   // a dead host can leave a plain ::connect hanging for 20+ s
+        int responseTimeoutMs = 6000;  // per request, then the connection is dropped (same as Python)
+        int udpRetries = 2;            // UDP: resends after each responseTimeoutMs without a reply
+    };
+
+    // A device address ("D100", "X17", "W1A0", ...) parsed and range-checked once. Every read/write
+    // takes one; strings convert implicitly (parsed on each call), so hot paths should keep
+    // a DeviceAddress around or use the compile-time checked "D100"_dev literal.
+    struct DeviceAddress {
+        char device = 'D';
+        uint8_t code = 0xA8;
+        int number = 0;
+        int base = 10;
+        bool bit = false; // bit device: one word point covers 16 addresses
+
+        constexpr DeviceAddress() = default;
+        constexpr DeviceAddress(const char* text) : DeviceAddress(parse(text)) {}
+        DeviceAddress(const std::string& text) : DeviceAddress(parse(text)) {}
+
+        static constexpr DeviceAddress parse(std::string_view text) {
+            if (text.empty()) {
+                invalidAddress("Headdevice cannot be empty", text);
+            }
+            const DeviceInfo* info = findDevice(text[0]);
+            if (!info) {
+                invalidAddress("Invalid device in headdevice: ", text);
+            }
+            // Address check similar to check_user_data_format
+            if (text.size() < 2) {
+                invalidAddress("No address after device in headdevice: ", text);
+            }
+            DeviceAddress result;
+            if (!parseNumber(text.substr(1), info->base, result.number)) {
+                invalidAddress("Invalid address format in headdevice: ", text);
+            }
+            if (result.number > info->maxAddr) {
+                invalidAddress("Address out of range in headdevice: ", text, result.number, info->maxAddr);
+            }
+            result.device = info->name;
+            result.code = info->code;
+            result.base = info->base;
+            result.bit = info->bit;
+            return result;
+        }
+    };
+
     MCProtocol() : sock(INVALID_SOCKET), is_connected(false) {
 #ifdef _WIN32
         WSADATA wsaData;
@@ -42,7 +119,6 @@ public:
             throw std::runtime_error("WSAStartup failed");
         }
 #endif
-        initializeTables();
     }
 
     ~MCProtocol() {
@@ -52,380 +128,1430 @@ public:
 #endif
     }
 
+    enum class ConnectState {
+        Pending,   // handshake still running
+        Connected,
+        Failed
+    };
+
     bool connect(const std::string& host, int port) {
+        return connect(host, port, SocketOptions());
+    }
+
+    // Fails (returns false) if the handshake takes longer than options.connectTimeoutMs
+    bool connect(const std::string& host, int port, const SocketOptions& options) {
+        if (!beginConnect(host, port, options)) {
+            return false;
+        }
+        if (pollConnect(options.connectTimeoutMs) == ConnectState::Connected) {
+            return true;
+        }
+        disconnect();
+        return false;
+    }
+
+    // Start a non-blocking connect and return at once; drive it with pollConnect(). Lets
+    // one thread bring up several connections without stalling on a dead host.
+    bool beginConnect(const std::string& host, int port, const SocketOptions& options) {
         // ensure clean
         if (sock != INVALID_SOCKET) {
             disconnect();
         }
 
-        sock = socket(AF_INET, SOCK_STREAM, 0);
+        // A connected UDP socket needs no handshake; pollConnect() finds it ready at once
+        bool udp = options.transport == Transport::UDP;
+        sock = socket(AF_INET, udp ? SOCK_DGRAM : SOCK_STREAM, udp ? IPPROTO_UDP : 0);
         if (sock == INVALID_SOCKET) {
             return false;
         }
+        socket_options = options;
+        // Buffer sizes before the handshake, while the window can still be negotiated
+        if (options.sendBufferBytes > 0) {
+            setsockopt(sock, SOL_SOCKET, SO_SNDBUF, (const char*)&options.sendBufferBytes, sizeof(int));
+        }
+        if (options.receiveBufferBytes > 0) {
+            setsockopt(sock, SOL_SOCKET, SO_RCVBUF, (const char*)&options.receiveBufferBytes, sizeof(int));
+        }
 
         sockaddr_in serverAddr{};
         serverAddr.sin_family = AF_INET;
         serverAddr.sin_port = htons(port);
 
-        if (inet_pton(AF_INET, host.c_str(), &serverAddr.sin_addr) <= 0) {
+        if (inet_pton(AF_INET, host.c_str(), &serverAddr.sin_addr) <= 0 ||
+            !startConnect(sock, serverAddr)) {
             closesocket(sock);
             sock = INVALID_SOCKET;
             return false;
         }
+        return true;
+    }
 
-        if (::connect(sock, (struct sockaddr*)&serverAddr, sizeof(serverAddr)) < 0) {
+    // Wait up to waitMs (0 = just check) for the connect begun above. On Failed the
+    // socket is closed; the caller owns the deadline and calls disconnect() to give up.
+    ConnectState pollConnect(int waitMs = 0) {
+        if (is_connected) {
+            return ConnectState::Connected;
+        }
+        if (sock == INVALID_SOCKET) {
+            return ConnectState::Failed;
+        }
+        int ready = waitConnected(sock, waitMs);
+        if (ready == 0) {
+            return ConnectState::Pending;
+        }
+        if (ready < 0) {
             closesocket(sock);
             sock = INVALID_SOCKET;
-            return false;
+            return ConnectState::Failed;
         }
 
-        // Set timeout to 6 seconds (same as Python)
-#ifdef _WIN32
-        DWORD timeout = 6000;
-        setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, (const char*)&timeout, sizeof(timeout));
-        setsockopt(sock, SOL_SOCKET, SO_SNDTIMEO, (const char*)&timeout, sizeof(timeout));
-#else
-        struct timeval tv {};
-        tv.tv_sec = 6;
-        tv.tv_usec = 0;
-        setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, (const char*)&tv, sizeof(tv));
-        setsockopt(sock, SOL_SOCKET, SO_SNDTIMEO, (const char*)&tv, sizeof(tv));
-#endif
+        applySocketOptions(sock, socket_options);
+
+        if (loop) {
+            std::lock_guard<std::mutex> lock(channel_mutex);
+            attachChannel();
+        }
 
+        monitor_id = 0;
         is_connected = true;
-        return true;
+        return ConnectState::Connected;
     }
 
     void disconnect() {
-        if (sock != INVALID_SOCKET) {
+        std::shared_ptr<MCEventLoop::Channel> ch;
+        {
+            std::lock_guard<std::mutex> lock(channel_mutex);
+            ch.swap(channel);
+        }
+        if (ch) {
+            // The loop owns the socket now; it fails pending requests and closes it
+            loop->closeChannel(ch);
+            sock = INVALID_SOCKET;
+        }
+        else if (sock != INVALID_SOCKET) {
             closesocket(sock);
             sock = INVALID_SOCKET;
         }
         is_connected = false;
+        monitor_id = 0;
+        in_flight.clear();
+        parked_replies.clear();
     }
 
     bool isConnected() const {
-        return is_connected;
+        if (!is_connected) {
+            return false;
+        }
+        std::lock_guard<std::mutex> lock(channel_mutex);
+        return !channel || !channel->closed;
+    }
+
+    // Route all traffic through 'eventLoop' from the next connect() on (or right away if
+    // already connected). Blocking calls still work: they submit to the loop and wait.
+    // The loop must outlive this object.
+    void attach(MCEventLoop& eventLoop) {
+        loop = &eventLoop;
+        if (is_connected && sock != INVALID_SOCKET) {
+            std::lock_guard<std::mutex> lock(channel_mutex);
+            if (!channel) {
+                attachChannel();
+            }
+        }
+    }
+
+    bool isAttached() const {
+        return loop != nullptr;
+    }
+
+    // Frame type and pipeline depth of an attached connection are fixed at connect()
+    void setFrameType(FrameType type) {
+        frame_type = type;
+    }
+
+    FrameType getFrameType() const {
+        return frame_type;
+    }
+
+    // Options of the current (or last) connection
+    const SocketOptions& socketOptions() const {
+        return socket_options;
+    }
+
+    // Max requests on the wire before submit_* waits for a reply
+    void setPipelineDepth(int depth) {
+        pipeline_depth = std::max(1, depth);
     }
 
     // Read Word (Signed 16-bit)
-    std::vector<int16_t> read_sign_word(const std::string& headdevice, int length) {
+    std::vector<int16_t> read_sign_word(const DeviceAddress& headdevice, int length) {
         checkConnected();
-        validateRequest(headdevice, "read_sign_word", length);
-        std::vector<uint8_t> response = sendRequest(headdevice, length, "read_word");
+        validateLength("read_sign_word", length);
+        const std::vector<uint8_t>& response = sendRequest(headdevice, length, Frame::ReadWord);
         return parseWordResponse<int16_t>(response, length);
     }
 
     // Read DWord (Signed 32-bit)
-    std::vector<int32_t> read_sign_dword(const std::string& headdevice, int length) {
+    std::vector<int32_t> read_sign_dword(const DeviceAddress& headdevice, int length) {
         checkConnected();
-        validateRequest(headdevice, "read_sign_Dword", length);
+        validateLength("read_sign_Dword", length);
         // Python uses read_word frame with length*2 points
-        std::vector<uint8_t> response = sendRequest(headdevice, length * 2, "read_word");
+        const std::vector<uint8_t>& response = sendRequest(headdevice, length * 2, Frame::ReadWord);
         return parseDWordResponse<int32_t>(response, length);
     }
 
+    struct RandomReadResult {
+        std::vector<int16_t> words;
+        std::vector<int32_t> dwords;
+    };
+
+    // Random Read (0x0403): scattered word and dword devices in one round trip
+    RandomReadResult read_random(const std::vector<DeviceAddress>& words,
+        const std::vector<DeviceAddress>& dwords)
+    {
+        checkConnected();
+        checkDeviceList("read_random", words, dwords);
+
+        RequestBuffer frame;
+        encodeDeviceList(frame, Frame::ReadRandom, words, dwords);
+
+        // Reply carries all words first, then all dwords (in word units)
+        int replyWords = static_cast<int>(words.size() + dwords.size() * 2);
+        const std::vector<uint8_t>& response = sendPacket(frame, replyWords);
+        return parseRandomResponse(response, static_cast<int>(words.size()), static_cast<int>(dwords.size()));
+    }
+
+    // Monitor registration (0x0801): the PLC keeps this word/dword device list for the
+    // connection, and read_monitor() (0x0802) fetches it with a bare command - no device
+    // descriptors on the wire or for the PLC to parse on every poll. Same limits as
+    // read_random. A reconnect forgets it; monitorId() then reads 0.
+    void register_monitor(const std::vector<DeviceAddress>& words,
+        const std::vector<DeviceAddress>& dwords)
+    {
+        checkConnected();
+        checkDeviceList("register_monitor", words, dwords);
+
+        RequestBuffer frame;
+        encodeDeviceList(frame, Frame::EntryMonitor, words, dwords);
+        monitor_id = 0;
+        (void)sendPacket(frame, 0);
+        monitor_words = static_cast<int>(words.size());
+        monitor_dwords = static_cast<int>(dwords.size());
+        monitor_id = ++monitor_serial;
+    }
+
+    RandomReadResult read_monitor() {
+        checkConnected();
+        if (monitor_id == 0) {
+            throw std::logic_error("read_monitor needs register_monitor on this connection");
+        }
+        RequestBuffer frame;
+        beginFrame(frame, Frame::ExecuteMonitor);
+        patchRequestLength(frame);
+        const std::vector<uint8_t>& response = sendPacket(frame, monitor_words + monitor_dwords * 2);
+        return parseRandomResponse(response, monitor_words, monitor_dwords);
+    }
+
+    // Nonzero while a monitor is registered on this connection; new value per register_monitor
+    uint32_t monitorId() const {
+        return monitor_id;
+    }
+
+    // Block spec for read_blocks: word blocks count words, bit blocks count bits
+    // (bit blocks travel as whole 16-bit words, so bits are rounded up to 16)
+    struct BlockRequest {
+        DeviceAddress headdevice;
+        int points;
+    };
+
+    struct BlockReadResult {
+        std::vector<std::vector<int16_t>> words; // one vector per word block
+        std::vector<std::vector<int>> bits;      // one vector per bit block, 0 or 1
+    };
+
+    // Multi-block Batch Read (0x0406): several contiguous word and bit blocks per frame.
+    // Requests over the per-frame block/point limits are split across as many frames as needed.
+    BlockReadResult read_blocks(const std::vector<BlockRequest>& wordBlocks,
+        const std::vector<BlockRequest>& bitBlocks)
+    {
+        checkConnected();
+        if (wordBlocks.empty() && bitBlocks.empty()) {
+            throw std::invalid_argument("read_blocks needs at least one block");
+        }
+
+        for (const BlockRequest& blk : wordBlocks) {
+            checkBlockPoints("read_blocks", blk.points);
+        }
+        for (const BlockRequest& blk : bitBlocks) {
+            checkBitDevice(blk.headdevice, "read_blocks bit block");
+            checkBlockPoints("read_blocks", blk.points);
+        }
+
+        BlockReadResult result;
+        std::vector<BlockChunk> chunks;
+        result.words.resize(wordBlocks.size());
+        for (size_t i = 0; i < wordBlocks.size(); ++i) {
+            const BlockRequest& blk = wordBlocks[i];
+            result.words[i].assign(blk.points, 0);
+            splitBlock(chunks, blk.headdevice, blk.points, false, i);
+        }
+        result.bits.resize(bitBlocks.size());
+        for (size_t i = 0; i < bitBlocks.size(); ++i) {
+            const BlockRequest& blk = bitBlocks[i];
+            result.bits[i].assign(blk.points, 0);
+            splitBlock(chunks, blk.headdevice, (blk.points + 15) / 16, true, i);
+        }
+
+        size_t next = 0;
+        while (next < chunks.size()) {
+            size_t end = packBlockFrame(chunks, next, 0);
+            RequestBuffer frame;
+            buildBlockFrame(frame, Frame::ReadBlocks, chunks, next, end, nullptr);
+
+            int replyWords = 0;
+            for (size_t c = next; c < end; ++c) replyWords += chunks[c].points;
+            const std::vector<uint8_t>& response = sendPacket(frame, replyWords);
+
+            // Reply order matches request order: word blocks first, then bit blocks
+            int offset = 11;
+            for (size_t c = next; c < end; ++c) {
+                const BlockChunk& ch = chunks[c];
+                for (int p = 0; p < ch.points; ++p, offset += 2) {
+                    if (offset + 1 >= static_cast<int>(response.size())) break;
+                    uint16_t raw = static_cast<uint16_t>(response[offset]) |
+                        static_cast<uint16_t>(response[offset + 1] << 8);
+                    if (!ch.bitBlock) {
+                        result.words[ch.index][ch.offset + p] = static_cast<int16_t>(raw);
+                        continue;
+                    }
+                    std::vector<int>& bits = result.bits[ch.index];
+                    for (int b = 0; b < 16; ++b) {
+                        size_t pos = static_cast<size_t>(ch.offset + p) * 16 + b;
+                        if (pos >= bits.size()) break;
+                        bits[pos] = (raw >> b) & 1;
+                    }
+                }
+            }
+            next = end;
+        }
+        return result;
+    }
+
+    struct WordBlock {
+        DeviceAddress headdevice;
+        std::vector<int16_t> data;
+    };
+
+    struct BitBlock {
+        DeviceAddress headdevice;
+        std::vector<int> data; // one entry per bit, padded with 0 to a whole word
+    };
+
+    // Multi-block Batch Write (0x1406). Oversized requests are split across frames,
+    // so the write is only atomic when it fits in a single frame.
+    bool write_blocks(const std::vector<WordBlock>& wordBlocks,
+        const std::vector<BitBlock>& bitBlocks)
+    {
+        checkConnected();
+        if (wordBlocks.empty() && bitBlocks.empty()) {
+            throw std::invalid_argument("write_blocks needs at least one block");
+        }
+
+        for (const WordBlock& blk : wordBlocks) {
+            checkBlockPoints("write_blocks", static_cast<int>(blk.data.size()));
+        }
+        for (const BitBlock& blk : bitBlocks) {
+            checkBitDevice(blk.headdevice, "write_blocks bit block");
+            checkBlockPoints("write_blocks", static_cast<int>(blk.data.size()));
+        }
+
+        // Flatten everything to raw words so chunks can slice it uniformly
+        std::vector<std::vector<uint16_t>> raw;
+        std::vector<BlockChunk> chunks;
+        for (size_t i = 0; i < wordBlocks.size(); ++i) {
+            const WordBlock& blk = wordBlocks[i];
+            raw.emplace_back(blk.data.begin(), blk.data.end());
+            splitBlock(chunks, blk.headdevice, static_cast<int>(blk.data.size()), false, raw.size() - 1);
+        }
+        for (size_t i = 0; i < bitBlocks.size(); ++i) {
+            const BitBlock& blk = bitBlocks[i];
+            std::vector<uint16_t> packed((blk.data.size() + 15) / 16, 0);
+            for (size_t b = 0; b < blk.data.size(); ++b) {
+                if (blk.data[b]) packed[b / 16] |= static_cast<uint16_t>(1u << (b % 16));
+            }
+            raw.push_back(std::move(packed));
+            splitBlock(chunks, blk.headdevice, static_cast<int>(raw.back().size()), true, raw.size() - 1);
+        }
+
+        size_t next = 0;
+        while (next < chunks.size()) {
+            // Each write block also spends 4 points of the frame budget on its header
+            size_t end = packBlockFrame(chunks, next, 4);
+            RequestBuffer frame;
+            buildBlockFrame(frame, Frame::WriteBlocks, chunks, next, end, &raw);
+            sendPacket(frame, 0);
+            next = end;
+        }
+        return true;
+    }
+
     // Read Bit (Returns 0 or 1)
-    std::vector<int> read_bit(const std::string& headdevice, int length) {
+    std::vector<int> read_bit(const DeviceAddress& headdevice, int length) {
         checkConnected();
-        validateRequest(headdevice, "read_bit", length);
-        std::vector<uint8_t> response = sendRequest(headdevice, length, "read_bit");
+        validateLength("read_bit", length);
+        const std::vector<uint8_t>& response = sendRequest(headdevice, length, Frame::ReadBit);
         return parseBitResponse(response, length);
     }
 
+    // Read Bit into caller storage, one byte (0 or 1) per point; returns out.size().
+    // Same decoding as read_bit without building a std::vector<int>.
+    size_t read_bit(const DeviceAddress& headdevice, std::span<uint8_t> out) {
+        checkConnected();
+        int length = static_cast<int>(out.size());
+        validateLength("read_bit", length);
+        const std::vector<uint8_t>& response = sendRequest(headdevice, length, Frame::ReadBit);
+        decodeBitResponse(response, out.data(), out.size());
+        return out.size();
+    }
+
+    // Packed bit access: word units (subcommand 0000) on a bit device, 16 points per word,
+    // bit 0 = head device. A quarter of the bytes of read_bit/write_bit for the same points.
+    // Most PLCs want the head device on a 16-point boundary (X0, X20, M16, ...).
+    void read_bits_packed(const DeviceAddress& headdevice, std::span<uint16_t> words) {
+        checkConnected();
+        checkBitDevice(headdevice, "read_bits_packed");
+        int length = static_cast<int>(words.size());
+        validateLength("read_bits_packed", length);
+        const std::vector<uint8_t>& response = sendRequest(headdevice, length, Frame::ReadWord);
+        for (size_t i = 0; i < words.size(); ++i) {
+            size_t offset = 11 + i * 2;
+            words[i] = offset + 1 < response.size()
+                ? static_cast<uint16_t>(response[offset] | (response[offset + 1] << 8))
+                : 0;
+        }
+    }
+
+    std::vector<uint16_t> read_bits_packed(const DeviceAddress& headdevice, int words) {
+        std::vector<uint16_t> result(std::max(words, 0));
+        read_bits_packed(headdevice, std::span<uint16_t>(result));
+        return result;
+    }
+
+    template <size_t N>
+    std::bitset<N> read_bits_packed(const DeviceAddress& headdevice) {
+        std::array<uint16_t, (N + 15) / 16> words{};
+        read_bits_packed(headdevice, std::span<uint16_t>(words));
+        std::bitset<N> bits;
+        for (size_t i = 0; i < N; ++i) {
+            bits[i] = (words[i / 16] >> (i % 16)) & 1;
+        }
+        return bits;
+    }
+
+    bool write_bits_packed(const DeviceAddress& headdevice, std::span<const uint16_t> words) {
+        checkConnected();
+        checkBitDevice(headdevice, "write_bits_packed");
+        int length = static_cast<int>(words.size());
+        validateLength("write_bits_packed", length);
+        RequestBuffer frame;
+        encodeRequest(frame, Frame::WriteWord, headdevice, length);
+        for (uint16_t w : words) {
+            frame.put16(w);
+        }
+        patchRequestLength(frame);
+        return sendWriteRequest(frame);
+    }
+
+    // Writes whole words: a size that is not a multiple of 16 clears the rest of the last word
+    template <size_t N>
+    bool write_bits_packed(const DeviceAddress& headdevice, const std::bitset<N>& bits) {
+        std::array<uint16_t, (N + 15) / 16> words{};
+        for (size_t i = 0; i < N; ++i) {
+            if (bits[i]) words[i / 16] |= static_cast<uint16_t>(1u << (i % 16));
+        }
+        return write_bits_packed(headdevice, std::span<const uint16_t>(words));
+    }
+
     // Write Bit
-    bool write_bit(const std::string& headdevice, const std::vector<int>& data) {
+    bool write_bit(const DeviceAddress& headdevice, const std::vector<int>& data) {
         checkConnected();
         int length = static_cast<int>(data.size());
-        validateRequest(headdevice, "write_bit", length);
+        validateLength("write_bit", length);
 
         if (length <= 0) {
             throw std::invalid_argument("write_bit length must be > 0");
         }
 
-        // Replicate Python logic WITHOUT big-int limit:
-        // if len is odd -> add one '0' nibble at the end
-        std::vector<int> hexDigits;
-        hexDigits.reserve(length + 1);
-        for (int v : data) {
-            hexDigits.push_back(v ? 1 : 0);
+        RequestBuffer frame;
+        encodeWriteBits(frame, headdevice, data);
+        return sendWriteRequest(frame);
+    }
+
+    // Random Bit Write (0x1402): scattered bit devices, each set to its own value, in one
+    // frame. The PLC applies the whole frame in one scan, so outputs change together.
+    bool write_random_bits(const std::vector<DeviceAddress>& devices, const std::vector<int>& values) {
+        checkConnected();
+        if (devices.size() != values.size()) {
+            throw std::invalid_argument("write_random_bits needs one value per device");
         }
-        if (length % 2 != 0) {
-            hexDigits.push_back(0);
+        validateLength("write_random_bits", static_cast<int>(devices.size()));
+        for (const auto& dev : devices) {
+            checkBitDevice(dev, "write_random_bits");
         }
+        RequestBuffer frame;
+        encodeWriteRandomBits(frame, devices, values);
+        return sendWriteRequest(frame);
+    }
+
+    // Write Word
+    bool write_sign_word(const DeviceAddress& headdevice, const std::vector<int16_t>& data) {
+        checkConnected();
+        int length = static_cast<int>(data.size());
+        validateLength("write_sign_word", length);
+        RequestBuffer frame;
+        encodeWriteWords(frame, headdevice, data);
+        return sendWriteRequest(frame);
+    }
 
-        int byteLength = static_cast<int>(hexDigits.size()) / 2;
-        std::vector<uint8_t> byteData;
-        byteData.reserve(byteLength);
+    // Write DWord
+    bool write_sign_dword(const DeviceAddress& headdevice, const std::vector<int32_t>& data) {
+        checkConnected();
+        int length = static_cast<int>(data.size());
+        validateLength("write_sign_Dword", length);
+        RequestBuffer frame;
+        encodeWriteDWords(frame, headdevice, data);
+        return sendWriteRequest(frame);
+    }
 
-        // Left-to-right mapping of hex digits to bytes (big-endian style)
-        // Each pair of digits -> one byte: high nibble, low nibble
-        for (int i = 0; i < byteLength; ++i) {
-            int hi = hexDigits[2 * i];
-            int lo = hexDigits[2 * i + 1];
-            uint8_t b = static_cast<uint8_t>(((hi & 0x0F) << 4) | (lo & 0x0F));
-            byteData.push_back(b);
+    // Pipelined requests (4E frames only).
+    // The request goes on the wire immediately; the reply is read and decoded when the
+    // future is first waited on (when attached, these are plain async_* calls). Replies for other serials that arrive meanwhile are
+    // parked until their own future asks for them. The futures touch the socket, so
+    // wait on them under the same lock that guards every other call on this object.
+    std::future<std::vector<int16_t>> submit_read_sign_word(const DeviceAddress& headdevice, int length) {
+        checkConnected();
+        if (loop) {
+            return async_read_sign_word(headdevice, length);
         }
+        validateLength("read_sign_word", length);
+        RequestBuffer frame;
+        encodeRequest(frame, Frame::ReadWord, headdevice, length);
+        uint16_t serial = submitPacket(frame);
+        return std::async(std::launch::deferred, [this, serial, length]() {
+            return parseWordResponse<int16_t>(awaitReply(serial), length);
+        });
+    }
 
-        return sendWriteRequest(headdevice, length, "write_bit", byteData);
+    std::future<std::vector<int32_t>> submit_read_sign_dword(const DeviceAddress& headdevice, int length) {
+        checkConnected();
+        if (loop) {
+            return async_read_sign_dword(headdevice, length);
+        }
+        validateLength("read_sign_Dword", length);
+        RequestBuffer frame;
+        encodeRequest(frame, Frame::ReadWord, headdevice, length * 2);
+        uint16_t serial = submitPacket(frame);
+        return std::async(std::launch::deferred, [this, serial, length]() {
+            return parseDWordResponse<int32_t>(awaitReply(serial), length);
+        });
     }
 
-    // Write Word
-    bool write_sign_word(const std::string& headdevice, const std::vector<int16_t>& data) {
+    std::future<std::vector<int>> submit_read_bit(const DeviceAddress& headdevice, int length) {
+        checkConnected();
+        if (loop) {
+            return async_read_bit(headdevice, length);
+        }
+        validateLength("read_bit", length);
+        RequestBuffer frame;
+        encodeRequest(frame, Frame::ReadBit, headdevice, length);
+        uint16_t serial = submitPacket(frame);
+        return std::async(std::launch::deferred, [this, serial, length]() {
+            return parseBitResponse(awaitReply(serial), length);
+        });
+    }
+
+    std::future<bool> submit_write_bit(const DeviceAddress& headdevice, const std::vector<int>& data) {
         checkConnected();
+        if (loop) {
+            return async_write_bit(headdevice, data);
+        }
         int length = static_cast<int>(data.size());
-        validateRequest(headdevice, "write_sign_word", length);
+        validateLength("write_bit", length);
+        RequestBuffer frame;
+        encodeWriteBits(frame, headdevice, data);
+        uint16_t serial = submitPacket(frame);
+        return std::async(std::launch::deferred, [this, serial]() {
+            (void)awaitReply(serial);
+            return true;
+        });
+    }
 
-        std::vector<uint8_t> byteData;
-        byteData.reserve(data.size() * 2);
-        for (int16_t val : data) {
-            byteData.push_back(static_cast<uint8_t>(val & 0xFF));
-            byteData.push_back(static_cast<uint8_t>((val >> 8) & 0xFF));
+    std::future<bool> submit_write_sign_word(const DeviceAddress& headdevice, const std::vector<int16_t>& data) {
+        checkConnected();
+        if (loop) {
+            return async_write_sign_word(headdevice, data);
         }
-        return sendWriteRequest(headdevice, length, "write_word", byteData);
+        int length = static_cast<int>(data.size());
+        validateLength("write_sign_word", length);
+        RequestBuffer frame;
+        encodeWriteWords(frame, headdevice, data);
+        uint16_t serial = submitPacket(frame);
+        return std::async(std::launch::deferred, [this, serial]() {
+            (void)awaitReply(serial);
+            return true;
+        });
     }
 
-    // Write DWord
-    bool write_sign_dword(const std::string& headdevice, const std::vector<int32_t>& data) {
+    // Asynchronous requests (need attach()).
+    // Argument errors throw immediately; transport and PLC errors arrive through the
+    // future or the callback's exception_ptr. Callbacks run on the event-loop thread
+    // and must not block or make blocking calls on this object.
+    template <typename T>
+    using Callback = std::function<void(T result, std::exception_ptr error)>;
+
+    void async_read_sign_word(const DeviceAddress& headdevice, int length, Callback<std::vector<int16_t>> done) {
+        checkConnected();
+        validateLength("read_sign_word", length);
+        RequestBuffer frame;
+        encodeRequest(frame, Frame::ReadWord, headdevice, length);
+        asyncCall<std::vector<int16_t>>(frame.toVector(),
+            [length](const std::vector<uint8_t>& r) { return parseWordResponse<int16_t>(r, length); },
+            std::move(done));
+    }
+
+    void async_read_sign_dword(const DeviceAddress& headdevice, int length, Callback<std::vector<int32_t>> done) {
+        checkConnected();
+        validateLength("read_sign_Dword", length);
+        RequestBuffer frame;
+        encodeRequest(frame, Frame::ReadWord, headdevice, length * 2);
+        asyncCall<std::vector<int32_t>>(frame.toVector(),
+            [length](const std::vector<uint8_t>& r) { return parseDWordResponse<int32_t>(r, length); },
+            std::move(done));
+    }
+
+    void async_read_bit(const DeviceAddress& headdevice, int length, Callback<std::vector<int>> done) {
+        checkConnected();
+        validateLength("read_bit", length);
+        RequestBuffer frame;
+        encodeRequest(frame, Frame::ReadBit, headdevice, length);
+        asyncCall<std::vector<int>>(frame.toVector(),
+            [length](const std::vector<uint8_t>& r) { return parseBitResponse(r, length); },
+            std::move(done));
+    }
+
+    void async_write_bit(const DeviceAddress& headdevice, const std::vector<int>& data, Callback<bool> done) {
         checkConnected();
         int length = static_cast<int>(data.size());
-        validateRequest(headdevice, "write_sign_Dword", length);
+        validateLength("write_bit", length);
+        RequestBuffer frame;
+        encodeWriteBits(frame, headdevice, data);
+        asyncCall<bool>(frame.toVector(),
+            [](const std::vector<uint8_t>&) { return true; }, std::move(done));
+    }
 
-        std::vector<uint8_t> byteData;
-        byteData.reserve(data.size() * 4);
-        for (int32_t val : data) {
-            byteData.push_back(static_cast<uint8_t>(val & 0xFF));
-            byteData.push_back(static_cast<uint8_t>((val >> 8) & 0xFF));
-            byteData.push_back(static_cast<uint8_t>((val >> 16) & 0xFF));
-            byteData.push_back(static_cast<uint8_t>((val >> 24) & 0xFF));
-        }
-        // Length in frame is in WORDs, so *2
-        return sendWriteRequest(headdevice, length * 2, "write_word", byteData);
+    void async_write_sign_word(const DeviceAddress& headdevice, const std::vector<int16_t>& data, Callback<bool> done) {
+        checkConnected();
+        int length = static_cast<int>(data.size());
+        validateLength("write_sign_word", length);
+        RequestBuffer frame;
+        encodeWriteWords(frame, headdevice, data);
+        asyncCall<bool>(frame.toVector(),
+            [](const std::vector<uint8_t>&) { return true; }, std::move(done));
+    }
+
+    std::future<std::vector<int16_t>> async_read_sign_word(const DeviceAddress& headdevice, int length) {
+        return toFuture<std::vector<int16_t>>([&](Callback<std::vector<int16_t>> done) {
+            async_read_sign_word(headdevice, length, std::move(done));
+        });
+    }
+
+    std::future<std::vector<int32_t>> async_read_sign_dword(const DeviceAddress& headdevice, int length) {
+        return toFuture<std::vector<int32_t>>([&](Callback<std::vector<int32_t>> done) {
+            async_read_sign_dword(headdevice, length, std::move(done));
+        });
+    }
+
+    std::future<std::vector<int>> async_read_bit(const DeviceAddress& headdevice, int length) {
+        return toFuture<std::vector<int>>([&](Callback<std::vector<int>> done) {
+            async_read_bit(headdevice, length, std::move(done));
+        });
+    }
+
+    std::future<bool> async_write_bit(const DeviceAddress& headdevice, const std::vector<int>& data) {
+        return toFuture<bool>([&](Callback<bool> done) {
+            async_write_bit(headdevice, data, std::move(done));
+        });
+    }
+
+    std::future<bool> async_write_sign_word(const DeviceAddress& headdevice, const std::vector<int16_t>& data) {
+        return toFuture<bool>([&](Callback<bool> done) {
+            async_write_sign_word(headdevice, data, std::move(done));
+        });
     }
 
 private:
+    friend struct MCProtocolTestAccess; // tests/testAccess.h: encoders and decoders, no socket
+
     SOCKET sock;
-    bool is_connected;
+    std::atomic<bool> is_connected;
+
+    MCEventLoop* loop = nullptr;
+    std::shared_ptr<MCEventLoop::Channel> channel; // set while attached and connected
+    mutable std::mutex channel_mutex;
+
+    FrameType frame_type = FrameType::E3;
+    int pipeline_depth = 8;
+    SocketOptions socket_options;
+    uint16_t next_serial = 0;
+    std::set<uint16_t> in_flight;                            // 4E serials sent, reply not yet read
+    std::map<uint16_t, std::vector<uint8_t>> parked_replies; // 4E replies read, not yet claimed
+
+    std::atomic<uint32_t> monitor_id{ 0 }; // 0 = no monitor registered on this connection
+    uint32_t monitor_serial = 0;
+    int monitor_words = 0;
+    int monitor_dwords = 0;
 
     struct DeviceInfo {
+        char name;
         uint8_t code;
-        int base; // 8, 10, 16
+        int base;    // 8, 10, 16
+        bool bit;    // bit device: one word point covers 16 addresses
+        int maxAddr; // max device number (io_table in Python)
     };
 
-    struct IOLimit {
-        int base;    // 8 / 10 / 16
-        int maxAddr; // max device number
+    // Mapping based on element_list / io_table in Python
+    static constexpr DeviceInfo kDeviceTable[] = {
+        { 'M', 0x90, 10, true,  32768 },
+        { 'L', 0x92, 10, true,  32768 },
+        { 'F', 0x93, 10, true,  32768 },
+        { 'D', 0xA8, 10, false, 8000 },
+        { 'R', 0xAF, 10, false, 32768 },
+        { 'B', 0xA0, 16, true,  32768 },
+        { 'W', 0xB4, 16, false, 32768 },
+        { 'X', 0x9C, 8,  true,  1024 },
+        { 'Y', 0x9D, 8,  true,  1024 },
     };
 
-    std::map<std::string, DeviceInfo> device_map;
-    std::map<std::string, std::vector<uint8_t>> base_packets;
-    std::map<char, IOLimit> io_table;
-    std::map<std::string, int> length_limit;
+    struct LengthLimit {
+        std::string_view func;
+        int limit;
+    };
+
+    // Length limits (length_limit in Python)
+    static constexpr LengthLimit kLengthLimits[] = {
+        { "read_sign_word", 960 },
+        { "read_sign_Dword", 480 },
+        { "write_sign_word", 960 },
+        { "write_sign_Dword", 480 },
+        { "read_bit", 3584 },
+        { "write_bit", 3584 },
+        { "read_bits_packed", 960 },  // words of 16 points
+        { "write_bits_packed", 960 },
+        { "read_random", 192 },  // words + dwords per 0x0403 frame
+        { "write_random_bits", 188 }, // bit points per 0x1402 frame
+        { "block_points", 960 }, // word points per 0x0406/0x1406 frame
+        { "block_count", 120 },  // word + bit blocks per 0x0406/0x1406 frame
+    };
+
+    // Request kinds, one per command template
+    enum class Frame {
+        ReadWord, ReadBit, WriteWord, WriteBit, ReadRandom, ReadBlocks, WriteBlocks,
+        EntryMonitor, ExecuteMonitor, WriteRandomBit
+    };
+
+    // Command + subcommand bytes per Frame, in enum order
+    static constexpr uint8_t kFrameCommand[][4] = {
+        { 0x01, 0x04, 0x00, 0x00 }, // ReadWord    0x0401 / 0000
+        { 0x01, 0x04, 0x01, 0x00 }, // ReadBit     0x0401 / 0001
+        { 0x01, 0x14, 0x00, 0x00 }, // WriteWord   0x1401 / 0000
+        { 0x01, 0x14, 0x01, 0x00 }, // WriteBit    0x1401 / 0001
+        { 0x03, 0x04, 0x00, 0x00 }, // ReadRandom  0x0403
+        { 0x06, 0x04, 0x00, 0x00 }, // ReadBlocks  0x0406
+        { 0x06, 0x14, 0x00, 0x00 }, // WriteBlocks 0x1406
+        { 0x01, 0x08, 0x00, 0x00 }, // EntryMonitor   0x0801
+        { 0x02, 0x08, 0x00, 0x00 }, // ExecuteMonitor 0x0802
+        { 0x02, 0x14, 0x01, 0x00 }, // WriteRandomBit 0x1402 / 0001
+    };
+
+    // 3E header up to the command: subheader, network, PC, IO, station, length (patched), timer
+    static constexpr uint8_t kFrameHeader[11] = {
+        0x50,0x00,0x00,0xFF,0xFF,0x03,0x00,0x00,0x00,0x00,0x00
+    };
+
+    // Fixed-capacity request frame. Encoders write straight into it, so building a
+    // request costs no heap allocation; declare it on the stack (no braces, the bytes
+    // don't need zeroing). Fits the largest frame the length limits allow plus a 4E prefix.
+    struct RequestBuffer {
+        uint8_t bytes[2048];
+        size_t size = 0;
+        Frame kind = Frame::ReadWord;
+
+        void put(uint8_t b) {
+            if (size >= sizeof(bytes)) {
+                throw std::length_error("PLC request frame too large");
+            }
+            bytes[size++] = b;
+        }
+
+        void put16(int v) {
+            put(static_cast<uint8_t>(v & 0xFF));
+            put(static_cast<uint8_t>((v >> 8) & 0xFF));
+        }
+
+        // Start Number (3 bytes little-endian) + Device Code
+        void putDevice(int addr, uint8_t code) {
+            put(static_cast<uint8_t>(addr & 0xFF));
+            put(static_cast<uint8_t>((addr >> 8) & 0xFF));
+            put(static_cast<uint8_t>((addr >> 16) & 0xFF));
+            put(code);
+        }
+
+        // Copy for the event loop, which queues requests by value
+        std::vector<uint8_t> toVector() const {
+            return std::vector<uint8_t>(bytes, bytes + size);
+        }
+    };
 
     void checkConnected() const {
-        if (!is_connected || sock == INVALID_SOCKET) {
+        if (!isConnected() || (!loop && sock == INVALID_SOCKET)) {
             throw std::runtime_error("Not connected to PLC");
         }
     }
 
-    void initializeTables() {
-        // Mapping based on element_list in Python
-        device_map["M"] = { 0x90, 10 };
-        device_map["L"] = { 0x92, 10 };
-        device_map["F"] = { 0x93, 10 };
-        device_map["D"] = { 0xA8, 10 };
-        device_map["R"] = { 0xAF, 10 };
-        device_map["B"] = { 0xA0, 16 };
-        device_map["W"] = { 0xB4, 16 };
-        device_map["X"] = { 0x9C, 8 };
-        device_map["Y"] = { 0x9D, 8 };
-
-        // IO ranges (io_table in Python)
-        io_table['X'] = { 8, 1024 };
-        io_table['Y'] = { 8, 1024 };
-        io_table['M'] = { 10, 32768 };
-        io_table['L'] = { 10, 32768 };
-        io_table['F'] = { 10, 32768 };
-        io_table['B'] = { 16, 32768 };
-        io_table['D'] = { 10, 8000 };
-        io_table['W'] = { 16, 32768 };
-        io_table['R'] = { 10, 32768 };
-
-        // Length limits (length_limit in Python)
-        length_limit["read_sign_word"] = 960;
-        length_limit["read_sign_Dword"] = 480;
-        length_limit["write_sign_word"] = 960;
-        length_limit["write_sign_Dword"] = 480;
-        length_limit["read_bit"] = 3584;
-        length_limit["write_bit"] = 3584;
-
-        // Main data byte templates (Header + Command)
-        base_packets["read_word"] = { 0x50,0x00,0x00,0xFF,0xFF,0x03,0x00,0x0C,0x00,0x00,0x00,0x01,0x04,0x00,0x00 };
-        base_packets["read_bit"] = { 0x50,0x00,0x00,0xFF,0xFF,0x03,0x00,0x0C,0x00,0x00,0x00,0x01,0x04,0x01,0x00 };
-        base_packets["write_bit"] = { 0x50,0x00,0x00,0xFF,0xFF,0x03,0x00,0x0C,0x00,0x00,0x00,0x01,0x14,0x01,0x00 };
-        base_packets["write_word"] = { 0x50,0x00,0x00,0xFF,0xFF,0x03,0x00,0x0C,0x00,0x00,0x00,0x01,0x14,0x00,0x00 };
-    }
-
-    void validateRequest(const std::string& headdevice,
-        const std::string& funcName,
-        int length) const
-    {
-        if (length <= 0) {
-            throw std::invalid_argument("Length must be > 0");
+    static constexpr const DeviceInfo* findDevice(char dev) {
+        if (dev >= 'a' && dev <= 'z') {
+            dev = static_cast<char>(dev - 'a' + 'A');
         }
-
-        if (headdevice.empty()) {
-            throw std::invalid_argument("Headdevice cannot be empty");
+        for (const DeviceInfo& info : kDeviceTable) {
+            if (info.name == dev) {
+                return &info;
+            }
         }
+        return nullptr;
+    }
 
-        char dev = static_cast<char>(std::toupper(static_cast<unsigned char>(headdevice[0])));
-        auto ioIt = io_table.find(dev);
-        if (ioIt == io_table.end()) {
-            throw std::invalid_argument("Invalid device in headdevice: " + headdevice);
+    static constexpr int lengthLimit(std::string_view funcName) {
+        for (const LengthLimit& l : kLengthLimits) {
+            if (l.func == funcName) {
+                return l.limit;
+            }
         }
+        return 0;
+    }
+
+    static constexpr bool isWrite(Frame kind) {
+        return kind == Frame::WriteWord || kind == Frame::WriteBit || kind == Frame::WriteBlocks ||
+            kind == Frame::WriteRandomBit;
+    }
 
-        auto lenIt = length_limit.find(funcName);
-        if (lenIt != length_limit.end()) {
-            if (length > lenIt->second) {
-                std::ostringstream oss;
-                oss << "Length exceeds limit for " << funcName
-                    << " (length=" << length
-                    << ", limit=" << lenIt->second << ")";
-                throw std::invalid_argument(oss.str());
+    // Device number in the device's radix; false on an empty, malformed or
+    // over-wide (> 3 bytes on the wire) number
+    static constexpr bool parseNumber(std::string_view digits, int base, int& value) {
+        if (digits.empty()) {
+            return false;
+        }
+        value = 0;
+        for (char c : digits) {
+            int digit = (c >= '0' && c <= '9') ? c - '0'
+                : (c >= 'A' && c <= 'F') ? c - 'A' + 10
+                : (c >= 'a' && c <= 'f') ? c - 'a' + 10
+                : base;
+            if (digit >= base) {
+                return false;
+            }
+            value = value * base + digit;
+            if (value > 0xFFFFFF) {
+                return false;
             }
         }
+        return true;
+    }
 
-        // Address check similar to check_user_data_format
-        const IOLimit& lim = ioIt->second;
+    // Not constexpr on purpose: reaching it while evaluating "..."_dev is a compile error
+    [[noreturn]] static void invalidAddress(const char* reason, std::string_view text,
+        int parsed = -1, int maxAddr = -1)
+    {
+        std::ostringstream oss;
+        oss << reason << text;
+        if (maxAddr >= 0) {
+            oss << " (parsed=" << parsed << ", max=" << maxAddr << ")";
+        }
+        throw std::invalid_argument(oss.str());
+    }
 
-        if (headdevice.size() < 2) {
-            throw std::invalid_argument("No address after device in headdevice: " + headdevice);
+    static void checkBitDevice(const DeviceAddress& headdevice, const char* funcName) {
+        if (!headdevice.bit) {
+            throw std::invalid_argument(std::string(funcName) + " needs a bit device (X, Y, M, L, F, B)");
         }
+    }
 
-        std::string addrStr = headdevice.substr(1); // full address for range check
-        int addr = 0;
-        try {
-            addr = std::stoi(addrStr, nullptr, lim.base);
+    static void validateLength(std::string_view funcName, int length) {
+        if (length <= 0) {
+            throw std::invalid_argument("Length must be > 0");
+        }
+
+        int limit = lengthLimit(funcName);
+        if (limit > 0 && length > limit) {
+            std::ostringstream oss;
+            oss << "Length exceeds limit for " << funcName
+                << " (length=" << length
+                << ", limit=" << limit << ")";
+            throw std::invalid_argument(oss.str());
         }
-        catch (...) {
-            throw std::invalid_argument("Invalid address format in headdevice: " + headdevice);
+    }
+
+    // Every block must carry points; the limit check is the same as any other length
+    static void checkBlockPoints(const char* funcName, int points) {
+        if (points <= 0) {
+            throw std::invalid_argument(std::string(funcName) + " block needs points > 0");
         }
+        validateLength(funcName, points);
+    }
 
-        if (addr < 0 || addr > lim.maxAddr) {
+    static void checkDeviceList(const char* funcName, const std::vector<DeviceAddress>& words,
+        const std::vector<DeviceAddress>& dwords)
+    {
+        int total = static_cast<int>(words.size() + dwords.size());
+        if (total <= 0) {
+            throw std::invalid_argument(std::string(funcName) + " needs at least one device");
+        }
+        if (total > lengthLimit("read_random")) {
             std::ostringstream oss;
-            oss << "Address out of range in headdevice: " << headdevice
-                << " (parsed=" << addr << ", max=" << lim.maxAddr << ")";
+            oss << "Device count exceeds limit for " << funcName << " (words=" << words.size()
+                << ", dwords=" << dwords.size()
+                << ", limit=" << lengthLimit("read_random") << ")";
             throw std::invalid_argument(oss.str());
         }
     }
 
-    std::vector<uint8_t> sendRequest(const std::string& headdevice, int length, const std::string& type) {
-        std::vector<uint8_t> packet = constructPacket(headdevice, length, type, {});
-        if (send(sock, reinterpret_cast<const char*>(packet.data()),
-            static_cast<int>(packet.size()), 0) < 0) {
-            throw std::runtime_error("Send failed");
+    // Random read / monitor entry body: word count, dword count, then one descriptor each
+    static void encodeDeviceList(RequestBuffer& out, Frame kind,
+        const std::vector<DeviceAddress>& words, const std::vector<DeviceAddress>& dwords)
+    {
+        beginFrame(out, kind);
+        out.put(static_cast<uint8_t>(words.size()));
+        out.put(static_cast<uint8_t>(dwords.size()));
+        for (const auto& dev : words) putDevice(out, dev);
+        for (const auto& dev : dwords) putDevice(out, dev);
+        patchRequestLength(out);
+    }
+
+    // Header + command/subcommand for 'kind'; the request length is patched once the body is in
+    static void beginFrame(RequestBuffer& out, Frame kind) {
+        std::memcpy(out.bytes, kFrameHeader, sizeof(kFrameHeader));
+        std::memcpy(out.bytes + sizeof(kFrameHeader), kFrameCommand[static_cast<int>(kind)], 4);
+        out.size = sizeof(kFrameHeader) + 4;
+        out.kind = kind;
+    }
+
+    // Batch read/write head: header, device, point count (write data follows)
+    static void encodeRequest(RequestBuffer& out, Frame kind, const DeviceAddress& headdevice, int length) {
+        beginFrame(out, kind);
+        putDevice(out, headdevice);
+        out.put16(length);
+        patchRequestLength(out);
+    }
+
+    // Nibble-per-point payload for bit writes: two points per byte, first point in the
+    // high nibble; an odd count is padded with a 0 nibble (Python's hex-string trick)
+    static void encodeWriteBits(RequestBuffer& out, const DeviceAddress& headdevice, const std::vector<int>& data) {
+        encodeRequest(out, Frame::WriteBit, headdevice, static_cast<int>(data.size()));
+        for (size_t i = 0; i < data.size(); i += 2) {
+            uint8_t hi = data[i] ? 0x10 : 0x00;
+            uint8_t lo = (i + 1 < data.size() && data[i + 1]) ? 0x01 : 0x00;
+            out.put(static_cast<uint8_t>(hi | lo));
         }
-        return receiveResponse(length, type);
+        patchRequestLength(out);
     }
 
-    bool sendWriteRequest(const std::string& headdevice, int length,
-        const std::string& type,
-        const std::vector<uint8_t>& data)
+    // Point count, then per point: device descriptor + one byte set (01) / reset (00)
+    static void encodeWriteRandomBits(RequestBuffer& out, const std::vector<DeviceAddress>& devices,
+        const std::vector<int>& values)
     {
-        std::vector<uint8_t> packet = constructPacket(headdevice, length, type, data);
-        if (send(sock, reinterpret_cast<const char*>(packet.data()),
-            static_cast<int>(packet.size()), 0) < 0) {
+        beginFrame(out, Frame::WriteRandomBit);
+        out.put(static_cast<uint8_t>(devices.size()));
+        for (size_t i = 0; i < devices.size(); ++i) {
+            putDevice(out, devices[i]);
+            out.put(values[i] ? 0x01 : 0x00);
+        }
+        patchRequestLength(out);
+    }
+
+    static void encodeWriteWords(RequestBuffer& out, const DeviceAddress& headdevice, const std::vector<int16_t>& data) {
+        encodeRequest(out, Frame::WriteWord, headdevice, static_cast<int>(data.size()));
+        for (int16_t val : data) {
+            out.put16(val);
+        }
+        patchRequestLength(out);
+    }
+
+    static void encodeWriteDWords(RequestBuffer& out, const DeviceAddress& headdevice, const std::vector<int32_t>& data) {
+        // Length in frame is in WORDs, so *2
+        encodeRequest(out, Frame::WriteWord, headdevice, static_cast<int>(data.size()) * 2);
+        for (int32_t val : data) {
+            out.put16(val & 0xFFFF);
+            out.put16((val >> 16) & 0xFFFF);
+        }
+        patchRequestLength(out);
+    }
+
+    const std::vector<uint8_t>& sendRequest(const DeviceAddress& headdevice, int length, Frame kind) {
+        RequestBuffer frame;
+        encodeRequest(frame, kind, headdevice, length);
+        return sendPacket(frame, length);
+    }
+
+    bool sendWriteRequest(const RequestBuffer& frame) {
+        if (loop) {
+            (void)loopRoundTrip(frame.toVector());
+            return true;
+        }
+        if (isDatagram()) {
+            (void)datagramRoundTrip(frame);
+            return true;
+        }
+        if (frame_type == FrameType::E4) {
+            (void)awaitReply(submitPacket(frame));
+            return true;
+        }
+        if (send(sock, reinterpret_cast<const char*>(frame.bytes),
+            static_cast<int>(frame.size), 0) < 0) {
             return false;
         }
-        (void)receiveResponse(0, "write_response");
+        (void)receiveResponse(0, frame.kind);
         return true;
     }
 
-    std::vector<uint8_t> constructPacket(const std::string& headdevice,
-        int length,
-        const std::string& type,
-        const std::vector<uint8_t>& writeData)
+    // One contiguous slice of a read_blocks/write_blocks block, sized to fit a frame
+    struct BlockChunk {
+        int addr;
+        uint8_t code;
+        int points;    // word units
+        bool bitBlock;
+        size_t index;  // which caller block it belongs to
+        int offset;    // word offset inside that block
+    };
+
+    void splitBlock(std::vector<BlockChunk>& chunks, const DeviceAddress& headdevice,
+        int points, bool bitBlock, size_t index) const
+    {
+        const int maxPoints = lengthLimit("block_points");
+        // Word access to a bit device moves 16 addresses per point
+        const int step = headdevice.bit ? 16 : 1;
+        for (int offset = 0; offset < points; offset += maxPoints) {
+            int n = std::min(maxPoints, points - offset);
+            chunks.push_back({ headdevice.number + offset * step, headdevice.code, n, bitBlock, index, offset });
+        }
+    }
+
+    // Returns one past the last chunk that fits in a frame starting at 'first'.
+    // Word chunks precede bit chunks in 'chunks', matching the frame layout.
+    size_t packBlockFrame(const std::vector<BlockChunk>& chunks, size_t first, int perBlockCost) const {
+        const int maxPoints = lengthLimit("block_points");
+        const int maxBlocks = lengthLimit("block_count");
+        int used = 0;
+        size_t end = first;
+        while (end < chunks.size() && static_cast<int>(end - first) < maxBlocks) {
+            int cost = chunks[end].points + perBlockCost;
+            if (end > first && used + cost > maxPoints) break;
+            used += cost;
+            ++end;
+        }
+        return end;
+    }
+
+    void buildBlockFrame(RequestBuffer& out, Frame kind,
+        const std::vector<BlockChunk>& chunks, size_t first, size_t end,
+        const std::vector<std::vector<uint16_t>>* writeData) const
     {
-        std::string devTypeStr = headdevice.substr(0, 1);
-        std::transform(devTypeStr.begin(), devTypeStr.end(), devTypeStr.begin(),
-            [](unsigned char c) { return static_cast<char>(std::toupper(c)); });
+        beginFrame(out, kind);
+        uint8_t wordCount = 0;
+        uint8_t bitCount = 0;
+        for (size_t c = first; c < end; ++c) {
+            (chunks[c].bitBlock ? bitCount : wordCount)++;
+        }
+        out.put(wordCount);
+        out.put(bitCount);
+
+        for (size_t c = first; c < end; ++c) {
+            const BlockChunk& ch = chunks[c];
+            out.putDevice(ch.addr, ch.code);
+            out.put16(ch.points);
+            if (writeData) {
+                const std::vector<uint16_t>& src = (*writeData)[ch.index];
+                for (int p = 0; p < ch.points; ++p) {
+                    out.put16(src[ch.offset + p]);
+                }
+            }
+        }
+        patchRequestLength(out);
+    }
+
+    static void putDevice(RequestBuffer& out, const DeviceAddress& headdevice) {
+        out.putDevice(headdevice.number, headdevice.code);
+    }
+
+    // Request data length = everything after the 9-byte header
+    static void patchRequestLength(RequestBuffer& out) {
+        size_t requestLen = out.size - 9;
+        out.bytes[7] = static_cast<uint8_t>(requestLen & 0xFF);
+        out.bytes[8] = static_cast<uint8_t>((requestLen >> 8) & 0xFF);
+    }
+
+    // The reply lands in the calling thread's reply buffer; it stays valid until that
+    // thread's next request
+    const std::vector<uint8_t>& sendPacket(const RequestBuffer& frame, int expectedPoints) {
+        if (loop) {
+            return replyBuffer() = loopRoundTrip(frame.toVector());
+        }
+        if (isDatagram()) {
+            return replyBuffer() = datagramRoundTrip(frame);
+        }
+        if (frame_type == FrameType::E4) {
+            return replyBuffer() = awaitReply(submitPacket(frame));
+        }
+        if (send(sock, reinterpret_cast<const char*>(frame.bytes),
+            static_cast<int>(frame.size), 0) < 0) {
+            throw std::runtime_error("Send failed");
+        }
+        return receiveResponse(expectedPoints, frame.kind);
+    }
+
+    // Caller holds channel_mutex
+    void attachChannel() {
+        const SocketOptions& o = socket_options;
+        channel = o.transport == Transport::UDP
+            ? loop->attachDatagram(sock, pipeline_depth, o.responseTimeoutMs, o.udpRetries)
+            : loop->attach(sock, frame_type == FrameType::E4, pipeline_depth, o.responseTimeoutMs);
+    }
+
+    bool isDatagram() const {
+        return socket_options.transport == Transport::UDP;
+    }
 
-        auto devIt = device_map.find(devTypeStr);
-        if (devIt == device_map.end()) {
-            throw std::invalid_argument("Invalid device type: " + devTypeStr);
+    // Unattached UDP: send the 4E request and wait for its serial, resending it after
+    // each response timeout (SO_RCVTIMEO) up to udpRetries times. Datagrams for other
+    // serials - late replies to earlier resends - are skipped.
+    std::vector<uint8_t> datagramRoundTrip(const RequestBuffer& packet) {
+        uint16_t serial = next_serial++;
+        RequestBuffer frame;
+        wrap4E(packet, serial, frame);
+        std::vector<uint8_t> reply;
+        for (int attempt = 0; attempt <= std::max(0, socket_options.udpRetries); ++attempt) {
+            if (send(sock, reinterpret_cast<const char*>(frame.bytes),
+                static_cast<int>(frame.size), 0) < 0) {
+                throw std::runtime_error("Send failed");
+            }
+            uint16_t got = 0;
+            while (recvDatagram(reply, got)) {
+                if (got == serial) {
+                    checkEndCode(reply);
+                    return reply;
+                }
+            }
         }
-        const DeviceInfo& info = devIt->second;
+        throw std::runtime_error("PLC response timeout");
+    }
 
-        // Python send_full_data_byte uses headdevice[1:6] (max 5 chars)
-        std::string addrStr;
-        if (headdevice.size() > 1) {
-            size_t maxLen = std::min(static_cast<size_t>(5), headdevice.size() - 1);
-            addrStr = headdevice.substr(1, maxLen);
+    // One 4E reply datagram, returned in 3E layout with its serial. False on timeout or
+    // receive error; malformed datagrams are skipped.
+    bool recvDatagram(std::vector<uint8_t>& out, uint16_t& serial) {
+        out.resize(8192);
+        while (true) {
+            int r = recv(sock, reinterpret_cast<char*>(out.data()), static_cast<int>(out.size()), 0);
+            if (r <= 0) {
+                return false;
+            }
+            size_t size = static_cast<size_t>(r);
+            if (size < 15 || out[0] != 0xD4 ||
+                13 + (static_cast<size_t>(out[11]) | (static_cast<size_t>(out[12]) << 8)) != size) {
+                continue;
+            }
+            serial = static_cast<uint16_t>(out[2]) | static_cast<uint16_t>(out[3] << 8);
+            // Drop serial + reserved so the reply parses like a 3E one (end code at 9, data at 11)
+            out.erase(out.begin() + 2, out.begin() + 6);
+            out.resize(size - 4);
+            return true;
+        }
+    }
+
+    void loopSubmit(std::vector<uint8_t> packet, MCEventLoop::Completion done) {
+        std::shared_ptr<MCEventLoop::Channel> ch;
+        {
+            std::lock_guard<std::mutex> lock(channel_mutex);
+            ch = channel;
         }
-        else {
-            throw std::invalid_argument("No address after device in headdevice: " + headdevice);
+        if (!ch) {
+            throw std::runtime_error("Not connected to PLC");
         }
+        loop->submit(ch, std::move(packet), std::move(done));
+    }
+
+    // Blocking call on an attached connection: submit and wait for the loop to answer
+    std::vector<uint8_t> loopRoundTrip(std::vector<uint8_t> packet) {
+        if (loop->isLoopThread()) {
+            throw std::logic_error("Blocking PLC call on the event-loop thread");
+        }
+        auto promise = std::make_shared<std::promise<std::vector<uint8_t>>>();
+        std::future<std::vector<uint8_t>> reply = promise->get_future();
+        loopSubmit(std::move(packet), [promise](std::vector<uint8_t>& r, std::exception_ptr error) {
+            if (error) {
+                promise->set_exception(error);
+            }
+            else {
+                promise->set_value(std::move(r));
+            }
+        });
+        std::vector<uint8_t> response = reply.get();
+        checkEndCode(response);
+        return response;
+    }
+
+    // Parsing runs on the loop thread, so 'parse' must not capture this
+    template <typename T, typename Parse>
+    void asyncCall(std::vector<uint8_t> packet, Parse parse, Callback<T> done) {
+        if (!loop) {
+            throw std::logic_error("async_* calls need attach() to an event loop");
+        }
+        loopSubmit(std::move(packet), [parse, done](std::vector<uint8_t>& reply, std::exception_ptr error) {
+            T value{};
+            if (!error) {
+                try {
+                    checkEndCode(reply);
+                    value = parse(reply);
+                }
+                catch (...) {
+                    error = std::current_exception();
+                }
+            }
+            done(std::move(value), error);
+        });
+    }
+
+    template <typename T, typename Start>
+    static std::future<T> toFuture(Start start) {
+        auto promise = std::make_shared<std::promise<T>>();
+        std::future<T> result = promise->get_future();
+        start([promise](T value, std::exception_ptr error) {
+            if (error) {
+                promise->set_exception(error);
+            }
+            else {
+                promise->set_value(std::move(value));
+            }
+        });
+        return result;
+    }
 
-        int addr = 0;
-        try {
-            addr = std::stoi(addrStr, nullptr, info.base);
+    // Wrap a 3E request in a 4E frame (subheader 54 00 + serial + reserved) and send it
+    uint16_t submitPacket(const RequestBuffer& packet) {
+        if (frame_type != FrameType::E4 && !isDatagram()) {
+            throw std::logic_error("Pipelined requests need 4E frames");
         }
-        catch (...) {
-            throw std::invalid_argument("Invalid address format: " + headdevice);
+        while (static_cast<int>(in_flight.size()) >= pipeline_depth) {
+            pumpReply();
         }
 
-        auto baseIt = base_packets.find(type);
-        if (baseIt == base_packets.end()) {
-            throw std::invalid_argument("Unknown packet type: " + type);
+        uint16_t serial = next_serial++;
+        RequestBuffer frame;
+        wrap4E(packet, serial, frame);
+
+        if (send(sock, reinterpret_cast<const char*>(frame.bytes),
+            static_cast<int>(frame.size), 0) < 0) {
+            throw std::runtime_error("Send failed");
         }
+        in_flight.insert(serial);
+        return serial;
+    }
 
-        std::vector<uint8_t> packet = baseIt->second;
+    static void wrap4E(const RequestBuffer& packet, uint16_t serial, RequestBuffer& frame) {
+        frame.put(0x54);
+        frame.put(0x00);
+        frame.put16(serial);
+        frame.put16(0x0000);
+        if (frame.size + packet.size - 2 > sizeof(frame.bytes)) {
+            throw std::length_error("PLC request frame too large");
+        }
+        std::memcpy(frame.bytes + frame.size, packet.bytes + 2, packet.size - 2);
+        frame.size += packet.size - 2;
+    }
 
-        // Append Start Number (3 bytes little-endian)
-        packet.push_back(static_cast<uint8_t>(addr & 0xFF));
-        packet.push_back(static_cast<uint8_t>((addr >> 8) & 0xFF));
-        packet.push_back(static_cast<uint8_t>((addr >> 16) & 0xFF));
+    // Pump replies until the one for 'serial' shows up; returns it in 3E layout
+    std::vector<uint8_t> awaitReply(uint16_t serial) {
+        auto it = parked_replies.find(serial);
+        while (it == parked_replies.end()) {
+            if (in_flight.find(serial) == in_flight.end()) {
+                throw std::runtime_error("No request in flight for serial " + std::to_string(serial));
+            }
+            pumpReply();
+            it = parked_replies.find(serial);
+        }
+        std::vector<uint8_t> reply = std::move(it->second);
+        parked_replies.erase(it);
+        checkEndCode(reply);
+        return reply;
+    }
 
-        // Append Device Code
-        packet.push_back(info.code);
+    // Read exactly one 4E reply off the socket and park it under its serial.
+    // Unattached UDP pipelining does not resend: a lost datagram fails its future.
+    void pumpReply() {
+        if (isDatagram()) {
+            std::vector<uint8_t> reply;
+            uint16_t serial = 0;
+            if (!recvDatagram(reply, serial)) {
+                throw std::runtime_error("PLC response timeout");
+            }
+            if (in_flight.erase(serial) != 0) {
+                parked_replies[serial] = std::move(reply);
+            }
+            return;
+        }
+        std::vector<uint8_t> frame(13);
+        recvExact(frame.data(), 13);
+        if (frame[0] != 0xD4) {
+            throw std::runtime_error("Unexpected subheader in 4E reply");
+        }
+        size_t dataLen = static_cast<size_t>(frame[11]) | (static_cast<size_t>(frame[12]) << 8);
+        frame.resize(13 + dataLen);
+        recvExact(frame.data() + 13, dataLen);
+
+        uint16_t serial = static_cast<uint16_t>(frame[2]) |
+            static_cast<uint16_t>(frame[3] << 8);
+        // Drop serial + reserved so the reply parses like a 3E one (end code at 9, data at 11)
+        frame.erase(frame.begin() + 2, frame.begin() + 6);
 
-        // Append Length (number of points) (2 bytes little-endian)
-        packet.push_back(static_cast<uint8_t>(length & 0xFF));
-        packet.push_back(static_cast<uint8_t>((length >> 8) & 0xFF));
+        if (in_flight.erase(serial) == 0) {
+            return; // stale reply for a serial nobody is waiting on
+        }
+        parked_replies[serial] = std::move(frame);
+    }
 
-        // Append Write Data if any
-        if (!writeData.empty()) {
-            packet.insert(packet.end(), writeData.begin(), writeData.end());
+    // Switch to non-blocking and start the handshake; false if it failed outright
+    static bool startConnect(SOCKET s, const sockaddr_in& addr) {
+#ifdef _WIN32
+        u_long mode = 1;
+        ioctlsocket(s, FIONBIO, &mode);
+        return ::connect(s, (const struct sockaddr*)&addr, sizeof(addr)) == 0 ||
+            WSAGetLastError() == WSAEWOULDBLOCK;
+#else
+        int flags = fcntl(s, F_GETFL, 0);
+        fcntl(s, F_SETFL, flags | O_NONBLOCK);
+        return ::connect(s, (const struct sockaddr*)&addr, sizeof(addr)) == 0 || errno == EINPROGRESS;
+#endif
+    }
 
-            // Python only patches length for writes (data_list != b"")
-            int requestLen = static_cast<int>(packet.size()) - 9;
-            packet[7] = static_cast<uint8_t>(requestLen & 0xFF);
-            packet[8] = static_cast<uint8_t>((requestLen >> 8) & 0xFF);
+    // 1 = connected (socket back in blocking mode), 0 = still pending, -1 = failed
+    static int waitConnected(SOCKET s, int waitMs) {
+        waitMs = std::max(0, waitMs);
+#ifdef _WIN32
+        // select, not WSAPoll: WSAPoll does not report a refused connect
+        fd_set writable, failed;
+        FD_ZERO(&writable);
+        FD_ZERO(&failed);
+        FD_SET(s, &writable);
+        FD_SET(s, &failed);
+        timeval tv{ waitMs / 1000, (waitMs % 1000) * 1000 };
+        int ready = select(0, nullptr, &writable, &failed, &tv);
+        if (ready == 0) {
+            return 0;
+        }
+        if (ready < 0 || !FD_ISSET(s, &writable)) {
+            return -1;
+        }
+#else
+        pollfd fd{};
+        fd.fd = s;
+        fd.events = POLLOUT;
+        int ready = ::poll(&fd, 1, waitMs);
+        if (ready == 0) {
+            return 0;
+        }
+        if (ready < 0) {
+            return -1;
+        }
+#endif
+        int err = 0;
+        socklen_t len = sizeof(err);
+        if (getsockopt(s, SOL_SOCKET, SO_ERROR, (char*)&err, &len) != 0 || err != 0) {
+            return -1;
         }
+#ifdef _WIN32
+        u_long mode = 0;
+        ioctlsocket(s, FIONBIO, &mode);
+#else
+        fcntl(s, F_SETFL, fcntl(s, F_GETFL, 0) & ~O_NONBLOCK);
+#endif
+        return 1;
+    }
 
-        return packet;
+    static void applySocketOptions(SOCKET s, const SocketOptions& options) {
+        int timeoutMs = std::max(1, options.responseTimeoutMs);
+#ifdef _WIN32
+        DWORD timeout = static_cast<DWORD>(timeoutMs);
+        setsockopt(s, SOL_SOCKET, SO_RCVTIMEO, (const char*)&timeout, sizeof(timeout));
+        setsockopt(s, SOL_SOCKET, SO_SNDTIMEO, (const char*)&timeout, sizeof(timeout));
+#else
+        struct timeval tv {};
+        tv.tv_sec = timeoutMs / 1000;
+        tv.tv_usec = (timeoutMs % 1000) * 1000;
+        setsockopt(s, SOL_SOCKET, SO_RCVTIMEO, (const char*)&tv, sizeof(tv));
+        setsockopt(s, SOL_SOCKET, SO_SNDTIMEO, (const char*)&tv, sizeof(tv));
+#endif
+        if (options.transport == Transport::UDP) {
+            return; // no Nagle and no connection to keep alive
+        }
+        int noDelay = options.noDelay ? 1 : 0;
+        setsockopt(s, IPPROTO_TCP, TCP_NODELAY, (const char*)&noDelay, sizeof(noDelay));
+        setKeepAlive(s, options.keepAlive, options.keepAliveIdleMs, options.keepAliveIntervalMs, options.keepAliveProbes);
     }
 
-    std::vector<uint8_t> receiveResponse(int expectedPoints, const std::string& type) {
-        std::vector<uint8_t> buffer;
-        buffer.reserve(64);
-        char tmp[4096];
+    static void setKeepAlive(SOCKET s, bool on, int idleMs, int intervalMs, int probes) {
+        idleMs = std::max(1, idleMs);
+        intervalMs = std::max(1, intervalMs);
+        int count = std::clamp(probes, 1, 127);
+#ifdef _WIN32
+        tcp_keepalive settings{};
+        settings.onoff = on ? 1 : 0;
+        settings.keepalivetime = static_cast<ULONG>(idleMs);
+        settings.keepaliveinterval = static_cast<ULONG>(intervalMs);
+        DWORD returned = 0;
+        WSAIoctl(s, SIO_KEEPALIVE_VALS, &settings, sizeof(settings), nullptr, 0, &returned, nullptr, nullptr);
+#ifdef TCP_KEEPCNT
+        // Windows 10 1703+; older versions keep their fixed 10 probes
+        if (on) {
+            setsockopt(s, IPPROTO_TCP, TCP_KEEPCNT, reinterpret_cast<const char*>(&count), sizeof(count));
+        }
+#endif
+#else
+        // The POSIX options take whole seconds; round up, so 1500 ms waits 2 s rather than
+        // probing sooner than asked
+        int enable = on ? 1 : 0;
+        int idle = idleMs / 1000 + (idleMs % 1000 != 0);
+        int interval = intervalMs / 1000 + (intervalMs % 1000 != 0);
+        setsockopt(s, SOL_SOCKET, SO_KEEPALIVE, &enable, sizeof(enable));
+        if (!on) {
+            return;
+        }
+        setsockopt(s, IPPROTO_TCP, TCP_KEEPIDLE, &idle, sizeof(idle));
+        setsockopt(s, IPPROTO_TCP, TCP_KEEPINTVL, &interval, sizeof(interval));
+        setsockopt(s, IPPROTO_TCP, TCP_KEEPCNT, &count, sizeof(count));
+#endif
+    }
 
-        // Read at least 11 bytes
-        int received = 0;
-        while (received < 11) {
-            int r = recv(sock, tmp, sizeof(tmp), 0);
+    void recvExact(uint8_t* dst, size_t len) {
+        size_t got = 0;
+        while (got < len) {
+            int r = recv(sock, reinterpret_cast<char*>(dst + got), static_cast<int>(len - got), 0);
             if (r <= 0) {
                 throw std::runtime_error("Receive failed or connection closed");
             }
-            buffer.insert(buffer.end(), tmp, tmp + r);
-            received += r;
+            got += static_cast<size_t>(r);
         }
+    }
 
+    static void checkEndCode(const std::vector<uint8_t>& buffer) {
         if (buffer.size() < 11) {
             throw std::runtime_error("Incomplete PLC response header");
         }
-
         // EndCode (bytes 9-10)
         uint16_t endCode = static_cast<uint16_t>(buffer[9]) |
             static_cast<uint16_t>(buffer[10] << 8);
@@ -434,37 +1560,65 @@ private:
             ss << "PLC Error: C"
                 << std::hex << std::uppercase << std::setw(3) << std::setfill('0')
                 << endCode;
-            throw std::runtime_error(ss.str());
+            throw PlcError(endCode, ss.str());
+        }
+    }
+
+    static std::vector<uint8_t>& replyBuffer() {
+        thread_local std::vector<uint8_t> buffer;
+        return buffer;
+    }
+
+    // One whole 3E reply: the 9-byte header, then exactly the data length it announces
+    // (end code + data). Never reads into the next frame and never returns a short one.
+    const std::vector<uint8_t>& receiveResponse(int expectedPoints, Frame kind) {
+        std::vector<uint8_t>& frame = replyBuffer();
+        frame.resize(9);
+        recvExact(frame.data(), 9);
+        if (frame[0] != 0xD0 || frame[1] != 0x00) {
+            throw std::runtime_error("Unexpected subheader in PLC response");
+        }
+        // Largest legal reply is a 960-word read (1922 bytes); anything far past that is garbage
+        size_t dataLen = static_cast<size_t>(frame[7]) | (static_cast<size_t>(frame[8]) << 8);
+        if (dataLen < 2 || dataLen > 4096) {
+            throw std::runtime_error("Malformed PLC response length");
         }
+        frame.resize(9 + dataLen);
+        recvExact(frame.data() + 9, dataLen);
 
-        // For writes, Python just checks error and returns "OK" � here, we just stop.
-        if (type == "write_response") {
-            return buffer;
+        // Error replies carry extra diagnostic bytes; they were consumed above, so the
+        // stream stays in sync after the throw
+        checkEndCode(frame);
+
+        // Writes: Python just checks the error and returns "OK"
+        if (isWrite(kind) || kind == Frame::EntryMonitor) {
+            return frame;
         }
 
         // Compute expected data bytes (Python formulas reduce to this)
-        int expectedDataBytes = 0;
-        if (type == "read_word") {
-            expectedDataBytes = expectedPoints * 2;           // words or dwords (length adjusted at call)
+        size_t expectedDataBytes = 0;
+        if (kind == Frame::ReadWord || kind == Frame::ReadRandom || kind == Frame::ReadBlocks ||
+            kind == Frame::ExecuteMonitor) {
+            expectedDataBytes = static_cast<size_t>(expectedPoints) * 2; // words or dwords (length adjusted at call)
         }
-        else if (type == "read_bit") {
-            expectedDataBytes = (expectedPoints + 1) / 2;     // 2 bits per byte (nibble encoding)
+        else if (kind == Frame::ReadBit) {
+            expectedDataBytes = (static_cast<size_t>(expectedPoints) + 1) / 2; // 2 bits per byte (nibble encoding)
         }
-
-        int totalExpected = 11 + expectedDataBytes;
-        while (static_cast<int>(buffer.size()) < totalExpected) {
-            int r = recv(sock, tmp, sizeof(tmp), 0);
-            if (r <= 0) {
-                break;
-            }
-            buffer.insert(buffer.end(), tmp, tmp + r);
+        if (frame.size() - 11 < expectedDataBytes) {
+            throw std::runtime_error("Short PLC response");
         }
+        return frame;
+    }
 
-        return buffer;
+    static RandomReadResult parseRandomResponse(const std::vector<uint8_t>& buffer, int words, int dwords) {
+        RandomReadResult result;
+        result.words = parseWordResponse<int16_t>(buffer, words);
+        result.dwords = parseDWordResponse<int32_t>(buffer, dwords, 11 + words * 2);
+        return result;
     }
 
     template <typename T>
-    std::vector<T> parseWordResponse(const std::vector<uint8_t>& buffer, int count) {
+    static std::vector<T> parseWordResponse(const std::vector<uint8_t>& buffer, int count) {
         std::vector<T> result;
         result.reserve(count);
         // Data starts at index 11
@@ -481,12 +1635,12 @@ private:
     }
 
     template <typename T>
-    std::vector<T> parseDWordResponse(const std::vector<uint8_t>& buffer, int count) {
+    static std::vector<T> parseDWordResponse(const std::vector<uint8_t>& buffer, int count, int dataOffset = 11) {
         std::vector<T> result;
         result.reserve(count);
-        // Data starts at index 11. Each DWord is 4 bytes.
+        // Data starts at index 11 (after any preceding words). Each DWord is 4 bytes.
         for (int i = 0; i < count; ++i) {
-            int offset = 11 + i * 4;
+            int offset = dataOffset + i * 4;
             if (offset + 3 >= static_cast<int>(buffer.size())) {
                 break;
             }
@@ -499,51 +1653,57 @@ private:
         return result;
     }
 
-    // Replicates Python's weird str(bytes) + digit-filter behaviour
-    std::vector<int> parseBitResponse(const std::vector<uint8_t>& buffer, int count) {
-        std::vector<int> result;
-
-        if (buffer.size() <= 11) {
-            // No data
-            result.assign(count, 0);
-            return result;
-        }
+    // Points carried by one reply byte under Python's str(bytes) + digit filter: the byte
+    // prints as two hex digits and only '0'/'1' digits survive. For well-formed replies
+    // (each nibble 0 or 1) that is simply high nibble, then low nibble.
+    struct BitDigits {
+        uint8_t count;
+        uint8_t bits[2];
+    };
 
-        // Build string like Python's str(binary_answer[11:])
-        std::stringstream ss;
-        ss << "b'";
-        for (size_t i = 11; i < buffer.size(); ++i) {
-            ss << "\\x"
-                << std::hex << std::nouppercase
-                << std::setw(2) << std::setfill('0')
-                << static_cast<int>(buffer[i]);
+    static constexpr std::array<BitDigits, 256> kBitDigits = [] {
+        std::array<BitDigits, 256> table{};
+        for (int b = 0; b < 256; ++b) {
+            BitDigits& d = table[b];
+            for (int nibble : { b >> 4, b & 0x0F }) {
+                if (nibble <= 1) {
+                    d.bits[d.count++] = static_cast<uint8_t>(nibble);
+                }
+            }
         }
-        ss << "'";
-
-        std::string dataStr = ss.str();
+        return table;
+    }();
 
-        std::vector<int> binDigits;
-        binDigits.reserve(dataStr.size());
-        for (char c : dataStr) {
-            if (c == '0') {
-                binDigits.push_back(0);
+    // Decode up to 'count' points from the data after the 11-byte header; missing points are 0
+    template <typename T>
+    static void decodeBitResponse(const std::vector<uint8_t>& buffer, T* out, size_t count) {
+        size_t n = 0;
+        for (size_t i = 11; i < buffer.size() && n < count; ++i) {
+            const BitDigits& d = kBitDigits[buffer[i]];
+            if (d.count == 2 && n + 2 <= count) {
+                out[n] = d.bits[0];
+                out[n + 1] = d.bits[1];
+                n += 2;
+                continue;
             }
-            else if (c == '1') {
-                binDigits.push_back(1);
+            for (uint8_t k = 0; k < d.count && n < count; ++k) {
+                out[n++] = d.bits[k];
             }
         }
-
-        for (int i = 0; i < count && i < static_cast<int>(binDigits.size()); ++i) {
-            result.push_back(binDigits[i]);
-        }
-
         // If fewer bits than requested, pad with 0 like a safe default
-        while (static_cast<int>(result.size()) < count) {
-            result.push_back(0);
-        }
+        std::fill(out + n, out + count, T(0));
+    }
 
+    static std::vector<int> parseBitResponse(const std::vector<uint8_t>& buffer, int count) {
+        std::vector<int> result(std::max(count, 0));
+        decodeBitResponse(buffer, result.data(), result.size());
         return result;
     }
 };
 
+// Compile-time checked device address: "D100"_dev, "Y17"_dev
+consteval MCProtocol::DeviceAddress operator""_dev(const char* text, size_t len) {
+    return MCProtocol::DeviceAddress::parse(std::string_view(text, len));
+}
+
 #endif // MCPROTOCOL_H
@@ -0,0 +1,334 @@
+#ifndef PLCMANAGER_H
+#define PLCMANAGER_H
+
+#include <map>
+#include <vector>
+#include <string>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <utility>
+#include <functional>
+#include <algorithm>
+#include <random>
+
+#include "mcProtocol.h"
+#include "mcEventLoop.h"
+#include "plcTagImage.h"
+#include "plcPollScheduler.h"
+
+// Any number of PLC connections, each with its own worker thread. Each session owns an
+// MCProtocol attached to the shared event loop (which does the socket I/O for all of
+// them) plus its own tag image and poll scheduler. A session's worker reconnects it,
+// runs its due polls and sleeps until the next one; polls block on their replies, so
+// a PLC that stops answering only ever holds up its own session. Sessions are handed
+// out as shared_ptr, so closing one while its worker or a caller is still using it is
+// safe.
+//
+// Link supervision: connects are non-blocking, requests time out after
+// responseTimeoutMs, and a session whose polls
+// have gone quiet for heartbeatMs sends a one-word read, so a pulled cable is noticed
+// within about heartbeatMs + responseTimeoutMs. A dropped link is redialled at once; further failures
+// back off exponentially with jitter up to 5 s. A link dropped before it answered a
+// single poll or heartbeat counts as one of those failures. A PLC refusing a request
+// (an error end code) keeps the link up: the scheduler backs off the tags it refuses.
+class PlcManager {
+public:
+    using Clock = std::chrono::steady_clock;
+    using Log = std::function<void(const std::string&)>;
+
+    // Link settings for one session; tighter timeouts than a bare MCProtocol since the
+    // session redials by itself
+    struct LinkSettings {
+        MCProtocol::SocketOptions socket;
+        int heartbeatMs = 500; // probe a link that has been idle this long
+
+        LinkSettings() {
+            socket.connectTimeoutMs = 1500;
+            socket.responseTimeoutMs = 1000; // a healthy PLC answers in a few scan times
+        }
+    };
+
+    class Session {
+    public:
+        explicit Session(int sessionId) : id(sessionId) {}
+
+        const int id;
+        const std::shared_ptr<MCProtocol> plc = std::make_shared<MCProtocol>();
+        PlcTagImage image;
+        PlcPollScheduler scheduler{ image };
+        std::atomic<bool> shouldConnect{ false };
+        std::atomic<bool> connected{ false };
+
+        void setTarget(const std::string& host, int port) {
+            std::lock_guard<std::mutex> lock(targetMutex);
+            targetHost = host;
+            targetPort = port;
+        }
+
+        std::pair<std::string, int> target() const {
+            std::lock_guard<std::mutex> lock(targetMutex);
+            return { targetHost, targetPort };
+        }
+
+        // Takes effect from the next connect
+        void setLink(const LinkSettings& value) {
+            std::lock_guard<std::mutex> lock(targetMutex);
+            linkSettings = value;
+        }
+
+        LinkSettings link() const {
+            std::lock_guard<std::mutex> lock(targetMutex);
+            return linkSettings;
+        }
+
+    private:
+        friend class PlcManager;
+
+        mutable std::mutex targetMutex;
+        std::string targetHost;
+        int targetPort = 0;
+        LinkSettings linkSettings;
+
+        std::atomic<bool> closed{ false }; // its worker disconnects it and exits
+
+        // Worker thread only
+        bool connecting = false;
+        Clock::time_point connectDeadline{};
+        Clock::time_point retryAt{};
+        int failures = 0; // connects failed (or dropped before any answer) in a row
+        int heartbeatMs = 0;
+        Clock::time_point heartbeatAt{};
+        uint32_t seenVersion = 0;
+        uint32_t connectedVersion = 0; // image version when the link came up
+        std::shared_ptr<std::atomic<bool>> heartbeatAnswered; // by this connection
+        std::string lastRefusal;       // logged already
+    };
+
+    // Workers are detached and may still be finishing a closed session at process exit,
+    // so the manager must never be destroyed (keep it in a leaked static, like the loop).
+    PlcManager(MCEventLoop& eventLoop, Log logger)
+        : loop(eventLoop), log(std::move(logger)) {}
+
+    PlcManager(const PlcManager&) = delete;
+    PlcManager& operator=(const PlcManager&) = delete;
+
+    // New session with no target yet; set one and raise shouldConnect to start it
+    std::shared_ptr<Session> create() {
+        std::shared_ptr<Session> session;
+        {
+            std::lock_guard<std::mutex> lock(sessionsMutex);
+            session = std::make_shared<Session>(nextId++);
+            session->plc->attach(loop);
+            sessions[session->id] = session;
+        }
+        std::thread(&PlcManager::workerLoop, this, session).detach();
+        return session;
+    }
+
+    std::shared_ptr<Session> open(const std::string& host, int port, const LinkSettings& link = LinkSettings()) {
+        std::shared_ptr<Session> session = create();
+        session->setLink(link);
+        session->setTarget(host, port);
+        session->shouldConnect = true;
+        return session;
+    }
+
+    std::shared_ptr<Session> get(int id) const {
+        std::lock_guard<std::mutex> lock(sessionsMutex);
+        auto it = sessions.find(id);
+        return it == sessions.end() ? nullptr : it->second;
+    }
+
+    // Forgets the handle at once; its worker drops the connection on the next pass (only
+    // the worker ever connects or disconnects a session), failing calls still in flight
+    bool close(int id) {
+        std::lock_guard<std::mutex> lock(sessionsMutex);
+        auto it = sessions.find(id);
+        if (it == sessions.end()) {
+            return false;
+        }
+        it->second->shouldConnect = false;
+        it->second->connected = false;
+        it->second->closed = true;
+        sessions.erase(it);
+        return true;
+    }
+
+private:
+    MCEventLoop& loop;
+    Log log;
+
+    mutable std::mutex sessionsMutex;
+    std::map<int, std::shared_ptr<Session>> sessions;
+    int nextId = 1;
+
+    // One per session, until it is closed
+    void workerLoop(std::shared_ptr<Session> session) {
+        while (!session->closed) {
+            // Wake for the next due poll, but at least every 200 ms to notice connect
+            // and disconnect requests
+            Clock::time_point wakeAt = service(*session);
+            std::this_thread::sleep_until(std::min(wakeAt, Clock::now() + std::chrono::milliseconds(200)));
+        }
+        service(*session); // shouldConnect is false: disconnects it
+    }
+
+    static constexpr MCProtocol::DeviceAddress kHeartbeatDevice = "D0"_dev;
+    static constexpr int kConnectCheckMs = 10;
+    static constexpr int kRetryFirstMs = 100; // a blip is usually over by then
+    static constexpr int kRetryBaseMs = 250;
+    static constexpr int kRetryMaxMs = 5000;
+
+    // Delay before the next attempt after 'failures' failed ones: 100 ms, then 250 ms
+    // doubling up to 5 s, each cut by a random amount up to half, so sessions (or PCs)
+    // that lost the same PLC at the same moment do not redial it in lockstep
+    static std::chrono::milliseconds retryDelay(int failures) {
+        if (failures <= 1) {
+            return std::chrono::milliseconds(kRetryFirstMs);
+        }
+        int delay = std::min(kRetryMaxMs, kRetryBaseMs << std::min(failures - 2, 5));
+        thread_local std::minstd_rand rng{ std::random_device{}() };
+        return std::chrono::milliseconds(std::uniform_int_distribution<int>(delay / 2, delay)(rng));
+    }
+
+    // One pass over a session: keep it connected (or disconnected) and run due polls.
+    // Returns when it next needs attention.
+    Clock::time_point service(Session& s) {
+        Clock::time_point now = Clock::now();
+        std::string tag = "PLC " + std::to_string(s.id) + ": ";
+
+        if (!s.shouldConnect) {
+            if (s.plc->isConnected() || s.connecting) {
+                s.plc->disconnect();
+                log(tag + "Forced Disconnect (shouldConnect=false)");
+            }
+            s.connecting = false;
+            s.connected = false;
+            s.failures = 0;
+            s.retryAt = now;
+            return now + std::chrono::milliseconds(200);
+        }
+
+        if (s.connecting) {
+            return continueConnect(s, tag, now);
+        }
+
+        if (s.plc->isConnected()) {
+            s.connected = true;
+            Clock::time_point wakeAt = now + std::chrono::milliseconds(200);
+            try {
+                wakeAt = std::min(wakeAt, s.scheduler.poll(*s.plc));
+                for (const PlcPollScheduler::Refusal& r : s.scheduler.takeRefusals()) {
+                    log(tag + "Tag " + std::to_string(r.tagId) + " refused by the PLC, backing off: " + r.error);
+                }
+                // Polls prove the link is alive; only a quiet one needs a probe
+                uint32_t version = s.image.version();
+                if (version != s.seenVersion) {
+                    s.seenVersion = version;
+                    s.heartbeatAt = now + std::chrono::milliseconds(s.heartbeatMs);
+                }
+                else if (now >= s.heartbeatAt) {
+                    // Fire and forget: no reply within the response timeout fails the channel, which
+                    // the next pass sees as a lost link. The worker never waits on it.
+                    s.plc->async_read_sign_word(kHeartbeatDevice, 1,
+                        [answered = s.heartbeatAnswered](std::vector<int16_t>, std::exception_ptr error) {
+                            if (!error) {
+                                *answered = true;
+                            }
+                        });
+                    s.heartbeatAt = now + std::chrono::milliseconds(s.heartbeatMs);
+                }
+                wakeAt = std::min(wakeAt, s.heartbeatAt);
+            }
+            catch (const MCProtocol::PlcError& ex) {
+                // The PLC answered, so the link is fine; redialling would only repeat this
+                if (s.lastRefusal != ex.what()) {
+                    s.lastRefusal = ex.what();
+                    log(tag + "Request refused by the PLC: " + ex.what());
+                }
+                wakeAt = now + std::chrono::milliseconds(PlcPollScheduler::kRefusedRetryMs);
+            }
+            catch (const std::exception& ex) {
+                log(tag + "Polling error: " + ex.what());
+                s.connected = false;
+                try { s.plc->disconnect(); } catch (...) {}
+                return linkLost(s, tag, now);
+            }
+            return wakeAt;
+        }
+
+        if (s.connected.exchange(false)) {
+            log(tag + "Connection lost.");
+            linkLost(s, tag, now);
+        }
+        if (now < s.retryAt) {
+            return s.retryAt;
+        }
+        auto [host, port] = s.target();
+        if (host.empty() || port <= 0) {
+            // Missing config
+            return now + std::chrono::milliseconds(500);
+        }
+
+        LinkSettings link = s.link();
+        log(tag + "Attempting to connect to " + host + ":" + std::to_string(port));
+        s.heartbeatMs = std::max(link.heartbeatMs, 1);
+        if (!s.plc->beginConnect(host, port, link.socket)) {
+            return connectFailed(s, tag, now);
+        }
+        s.connecting = true;
+        s.connectDeadline = now + std::chrono::milliseconds(std::max(link.socket.connectTimeoutMs, 1));
+        return continueConnect(s, tag, now);
+    }
+
+    // Check a pending handshake without waiting on it
+    Clock::time_point continueConnect(Session& s, const std::string& tag, Clock::time_point now) {
+        MCProtocol::ConnectState state = s.plc->pollConnect(0);
+        if (state == MCProtocol::ConnectState::Pending) {
+            if (now < s.connectDeadline) {
+                return std::min(s.connectDeadline, now + std::chrono::milliseconds(kConnectCheckMs));
+            }
+            s.plc->disconnect();
+            log(tag + "Connect timed out.");
+            state = MCProtocol::ConnectState::Failed;
+        }
+        s.connecting = false;
+        if (state == MCProtocol::ConnectState::Failed) {
+            return connectFailed(s, tag, now);
+        }
+        s.connected = true;
+        s.seenVersion = s.image.version();
+        s.connectedVersion = s.seenVersion;
+        s.heartbeatAnswered = std::make_shared<std::atomic<bool>>(false);
+        s.heartbeatAt = now + std::chrono::milliseconds(s.heartbeatMs);
+        s.lastRefusal.clear();
+        log(tag + "Connected successfully.");
+        return now; // poll right away
+    }
+
+    // Redial a dropped link straight away if it ever answered; one lost before its first
+    // answer counts as another failed connect (failures are only cleared by an answer),
+    // so a PLC that accepts and then drops every connection is redialled with backoff
+    Clock::time_point linkLost(Session& s, const std::string& tag, Clock::time_point now) {
+        bool answered = s.image.version() != s.connectedVersion ||
+            (s.heartbeatAnswered && *s.heartbeatAnswered);
+        if (!answered) {
+            return connectFailed(s, tag, now);
+        }
+        s.failures = 0;
+        s.retryAt = now;
+        return now;
+    }
+
+    Clock::time_point connectFailed(Session& s, const std::string& tag, Clock::time_point now) {
+        std::chrono::milliseconds delay = retryDelay(++s.failures);
+        log(tag + "Connection failed. Retrying in " + std::to_string(delay.count()) + " ms...");
+        s.retryAt = now + delay;
+        return s.retryAt;
+    }
+};
+
+#endif // PLCMANAGER_H
@@ -0,0 +1,519 @@
+#ifndef PLCPOLLSCHEDULER_H
+#define PLCPOLLSCHEDULER_H
+
+#include <vector>
+#include <mutex>
+#include <chrono>
+#include <algorithm>
+#include <stdexcept>
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
+#include <string>
+#include <utility>
+
+#include "mcProtocol.h"
+#include "plcTagImage.h"
+
+// Polls a list of tags, each at its own period, into a PlcTagImage. Everything due in
+// the same tick goes out as one multi-block read (0x0406, split only where the frame
+// limits force it), and tags on the same device whose ranges touch share a block.
+// So a 20 ms interlock bit costs one small frame every 20 ms and a 2 s counter rides
+// along only when it is due. Tags can be added/removed from any thread; poll() runs
+// on the poller thread only.
+class PlcPollScheduler {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    static constexpr int kMinPeriodMs = 10;
+    static constexpr int kMaxPeriodMs = 10000;
+    static constexpr int kTickMs = kMinPeriodMs; // tags due within one tick are read together
+
+    // One slot whose value moved past its tag's deadband in a poll
+    struct Change {
+        int tagId;
+        int slot;
+        int32_t value;
+        int32_t previous; // last reported value (0 on the first report after watch())
+    };
+
+    // Gets every change from one poll in one call, on the poller thread, after the
+    // scheduler's lock is released (so it may add/remove/watch tags)
+    using ChangeListener = std::function<void(const std::vector<Change>& changes)>;
+
+    // A tag the PLC refused to read (no such device on this model, address past its end,
+    // ...). The tag is left out of polls for a while, longer after each refusal in a row,
+    // and reported once per run of refusals.
+    struct Refusal {
+        int tagId;
+        uint16_t endCode;
+        std::string error;
+    };
+
+    static constexpr int kRefusedRetryMs = 1000;
+    static constexpr int kRefusedRetryMaxMs = 30000;
+
+    explicit PlcPollScheduler(PlcTagImage& image) : image(image) {}
+
+    void setChangeListener(ChangeListener listener) {
+        std::lock_guard<std::mutex> lock(mutex);
+        changeListener = std::move(listener);
+    }
+
+    // Report changes of 'id' to the listener. A word slot is reported once it moves at
+    // least 'deadband' away from the value last reported (0 = any change); bit slots
+    // report every edge. The next poll reports the tag's current values as a baseline.
+    bool watch(int id, int deadband) {
+        std::lock_guard<std::mutex> lock(mutex);
+        Tag* tag = findTag(id);
+        if (!tag) {
+            return false;
+        }
+        tag->watched = true;
+        tag->deadband = std::max(deadband, 0);
+        tag->reported.clear();
+        return true;
+    }
+
+    bool unwatch(int id) {
+        std::lock_guard<std::mutex> lock(mutex);
+        Tag* tag = findTag(id);
+        if (!tag) {
+            return false;
+        }
+        tag->watched = false;
+        tag->reported.clear();
+        return true;
+    }
+
+    // Poll 'points' consecutive devices from 'headdevice' every 'periodMs' (clamped to
+    // 10 ms - 10 s). Word devices fill one signed word per slot, bit devices one 0/1.
+    // Returns the tag id, which is also its first slot in the image, or -1 if the image
+    // has no room left. Throws std::invalid_argument on a bad point count.
+    int addTag(const MCProtocol::DeviceAddress& headdevice, int points, int periodMs) {
+        if (points <= 0 || points > PlcTagImage::kCapacity) {
+            throw std::invalid_argument("Poll tag points must be 1.." + std::to_string(PlcTagImage::kCapacity));
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        int slot = findFreeSlots(points);
+        if (slot < 0) {
+            return -1;
+        }
+        Tag tag;
+        tag.device = headdevice;
+        tag.points = points;
+        tag.periodMs = std::clamp(periodMs, kMinPeriodMs, kMaxPeriodMs);
+        tag.slot = slot;
+        tag.serial = nextSerial++;
+        tag.next = Clock::now();
+        tags.push_back(tag);
+        return slot;
+    }
+
+    bool removeTag(int id) {
+        std::lock_guard<std::mutex> lock(mutex);
+        Tag* tag = findTag(id);
+        if (!tag) {
+            return false;
+        }
+        tags.erase(tags.begin() + (tag - tags.data()));
+        return true;
+    }
+
+    void clear() {
+        std::lock_guard<std::mutex> lock(mutex);
+        tags.clear();
+    }
+
+    // Read every tag due this tick and publish it to the image. Returns when the next
+    // tag is due. Transport errors propagate; the tags stay due, so the next call retries
+    // them. When the PLC refuses a read, each tag in it is read on its own and only the
+    // ones it still refuses are backed off (see takeRefusals()).
+    //
+    // The fastest-period tag group is the steady-state set: it is registered once as a
+    // PLC monitor (0x0801) and fetched with a bare 0x0802 whenever any of it is due, so
+    // those polls carry no device descriptors. Everything else due goes out as 0x0406.
+    Clock::time_point poll(MCProtocol& plc) {
+        Clock::time_point now = Clock::now();
+        std::vector<Tag> due;
+        std::vector<Tag> fastest;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            int minPeriod = kMaxPeriodMs;
+            for (const Tag& t : tags) {
+                minPeriod = std::min(minPeriod, t.periodMs);
+                if (t.next < now + std::chrono::milliseconds(kTickMs)) {
+                    due.push_back(t);
+                }
+            }
+            if (due.empty()) {
+                return nextDue(now);
+            }
+            for (const Tag& t : tags) {
+                if (t.periodMs == minPeriod) {
+                    fastest.push_back(t);
+                }
+            }
+        }
+
+        // Monitor group: once any of it is due, all of it is read (keeps the group in phase)
+        std::vector<Tag> polled;
+        std::vector<Placement> placement;
+        if (syncMonitor(plc, fastest)) {
+            auto inMonitor = [&](const Tag& t) {
+                return std::find(monitorTags.begin(), monitorTags.end(), t.serial) != monitorTags.end();
+            };
+            if (std::any_of(due.begin(), due.end(), inMonitor)) {
+                int entry = 0;
+                for (const Tag& t : fastest) {
+                    polled.push_back(t);
+                    // Bit tags: offset in bits from their first (16-aligned) entry
+                    int offset = t.device.bit ? entry * 16 + (t.device.number & 15) : entry;
+                    placement.push_back({ Source::Monitor, t.device.bit, 0, offset });
+                    entry += monitorEntries(t);
+                }
+                due.erase(std::remove_if(due.begin(), due.end(), inMonitor), due.end());
+            }
+        }
+
+        std::vector<MCProtocol::BlockRequest> wordBlocks;
+        std::vector<MCProtocol::BlockRequest> bitBlocks;
+        packBlocks(due, wordBlocks, bitBlocks, polled, placement);
+
+        MCProtocol::RandomReadResult monitor;
+        if (!placement.empty() && placement.front().source == Source::Monitor) {
+            try {
+                monitor = plc.read_monitor();
+            }
+            catch (const MCProtocol::PlcError&) {
+                // Registered but refused on execution: leave the group due and read it
+                // with 0x0406 from the next poll on
+                monitorRejected = monitorTags;
+                monitorTags.clear();
+                monitorId = 0;
+                size_t monitored = static_cast<size_t>(std::count_if(placement.begin(), placement.end(),
+                    [](const Placement& p) { return p.source == Source::Monitor; }));
+                polled.erase(polled.begin(), polled.begin() + monitored);
+                placement.erase(placement.begin(), placement.begin() + monitored);
+            }
+        }
+        MCProtocol::BlockReadResult result;
+        std::vector<std::pair<uint64_t, MCProtocol::PlcError>> refused;
+        if (!wordBlocks.empty() || !bitBlocks.empty()) {
+            try {
+                result = plc.read_blocks(wordBlocks, bitBlocks);
+            }
+            catch (const MCProtocol::PlcError&) {
+                result = readEachAlone(plc, polled, placement, refused);
+            }
+        }
+
+        std::vector<Change> changes;
+        ChangeListener listener;
+        std::unique_lock<std::mutex> lock(mutex);
+        now = Clock::now();
+        image.beginUpdate();
+        for (size_t i = 0; i < polled.size(); ++i) {
+            // Skip tags removed (and maybe replaced in the same slots) during the read
+            auto it = std::find_if(tags.begin(), tags.end(),
+                [&](const Tag& t) { return t.serial == polled[i].serial; });
+            if (it == tags.end()) {
+                continue;
+            }
+            auto refusal = std::find_if(refused.begin(), refused.end(),
+                [&](const auto& r) { return r.first == it->serial; });
+            if (refusal != refused.end()) {
+                if (it->refusals++ == 0) {
+                    refusals.push_back({ it->slot, refusal->second.endCode, refusal->second.what() });
+                }
+                it->next = now + refusedRetryDelay(it->refusals);
+                continue;
+            }
+            it->refusals = 0;
+            const Placement& p = placement[i];
+            // First poll after watch(): report everything once as a baseline
+            bool baseline = it->watched && it->reported.empty();
+            if (baseline) {
+                it->reported.assign(it->points, 0);
+            }
+            for (int k = 0; k < it->points; ++k) {
+                int32_t value = p.source == Source::Monitor
+                    ? monitorValue(monitor, p, k)
+                    : blockValue(result, p, k);
+                image.set(it->slot + k, value);
+                if (it->watched) {
+                    noteChange(*it, k, value, baseline, changes);
+                }
+            }
+            // Stay on the period grid; after an overrun, restart from now instead of bursting
+            it->next += std::chrono::milliseconds(it->periodMs);
+            if (it->next < now) {
+                it->next = now + std::chrono::milliseconds(it->periodMs);
+            }
+        }
+        image.setCount(usedSlots());
+        image.endUpdate();
+        Clock::time_point next = nextDue(now);
+        if (!changes.empty()) {
+            listener = changeListener;
+        }
+        lock.unlock();
+
+        if (listener) {
+            listener(changes);
+        }
+        return next;
+    }
+
+    // Tags newly refused since the last call
+    std::vector<Refusal> takeRefusals() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return std::exchange(refusals, {});
+    }
+
+private:
+    friend struct PlcPollSchedulerTestAccess; // tests/testAccess.h: block packing, no PLC
+
+    struct Tag {
+        MCProtocol::DeviceAddress device;
+        int points = 0;
+        int periodMs = 0;
+        int slot = 0;
+        uint64_t serial = 0;
+        Clock::time_point next;
+        bool watched = false;
+        int deadband = 0;
+        std::vector<int32_t> reported; // last value reported per point; empty until the first report
+        int refusals = 0;              // polls in a row the PLC refused this tag
+    };
+
+    enum class Source { Block, Monitor };
+
+    // Where a polled tag's values sit: a read_blocks block + point offset, or a point
+    // offset into the monitor's entries. For bit tags the offset counts bits from the
+    // 16-aligned head of the block or of the tag's first monitor entry.
+    struct Placement {
+        Source source;
+        bool bit;
+        size_t block;
+        int offset;
+    };
+
+    PlcTagImage& image;
+    std::mutex mutex; // guards everything below
+    std::vector<Tag> tags;
+    uint64_t nextSerial = 0;
+    ChangeListener changeListener;
+    std::vector<Refusal> refusals; // not yet taken
+
+    // Poller thread only
+    std::vector<uint64_t> monitorTags;     // serials of the registered monitor group, entry order
+    uint32_t monitorId = 0;                // plc.monitorId() after registering it
+    std::vector<uint64_t> monitorRejected; // group the PLC refused (e.g. no 0x0801 support)
+
+    // Word entries a tag takes in the monitor: one per word, or one per 16-aligned word
+    // its bits touch
+    static int monitorEntries(const Tag& t) {
+        return t.device.bit ? ((t.device.number & 15) + t.points + 15) / 16 : t.points;
+    }
+
+    // Make sure the PLC's monitor holds exactly the 'group' tags; false if it can't
+    // (too many entries for one monitor, or the PLC rejected it)
+    bool syncMonitor(MCProtocol& plc, const std::vector<Tag>& group) {
+        std::vector<uint64_t> serials;
+        int entries = 0;
+        for (const Tag& t : group) {
+            serials.push_back(t.serial);
+            entries += monitorEntries(t);
+        }
+        if (serials.empty() || entries > 192 || serials == monitorRejected) {
+            return false;
+        }
+        if (serials == monitorTags && monitorId != 0 && plc.monitorId() == monitorId) {
+            return true;
+        }
+
+        std::vector<MCProtocol::DeviceAddress> words;
+        for (const Tag& t : group) {
+            // Word access to a bit device covers 16 points per entry, from a multiple of 16
+            int step = t.device.bit ? 16 : 1;
+            MCProtocol::DeviceAddress head = t.device;
+            if (head.bit) {
+                head.number &= ~15;
+            }
+            for (int e = 0; e < monitorEntries(t); ++e) {
+                MCProtocol::DeviceAddress dev = head;
+                dev.number += e * step;
+                words.push_back(dev);
+            }
+        }
+        monitorTags.clear();
+        monitorId = 0;
+        try {
+            plc.register_monitor(words, {});
+        }
+        catch (const MCProtocol::PlcError&) {
+            monitorRejected = serials; // e.g. no 0x0801 support; poll this group with 0x0406
+            return false;
+        }
+        monitorTags = std::move(serials);
+        monitorId = plc.monitorId();
+        return true;
+    }
+
+    // Sorts 'due' by device and packs it into word and bit blocks, tags whose ranges
+    // touch sharing one; appends each tag and where its values will sit
+    static void packBlocks(std::vector<Tag>& due, std::vector<MCProtocol::BlockRequest>& wordBlocks,
+        std::vector<MCProtocol::BlockRequest>& bitBlocks, std::vector<Tag>& polled,
+        std::vector<Placement>& placement)
+    {
+        // Sort by device so tags whose ranges touch can share a block
+        std::sort(due.begin(), due.end(), [](const Tag& a, const Tag& b) {
+            if (a.device.code != b.device.code) return a.device.code < b.device.code;
+            return a.device.number < b.device.number;
+        });
+
+        for (const Tag& t : due) {
+            std::vector<MCProtocol::BlockRequest>& blocks = t.device.bit ? bitBlocks : wordBlocks;
+            // Bit blocks are read as whole words, which must start on a multiple of 16
+            MCProtocol::DeviceAddress head = t.device;
+            if (head.bit) {
+                head.number &= ~15;
+            }
+            int end = t.device.number + t.points;
+            bool merged = false;
+            if (!blocks.empty()) {
+                MCProtocol::BlockRequest& last = blocks.back();
+                int lastEnd = last.headdevice.number + last.points;
+                if (last.headdevice.code == head.code && head.number <= lastEnd) {
+                    head = last.headdevice;
+                    end = std::max(lastEnd, end);
+                    merged = true;
+                }
+            }
+            int points = end - head.number;
+            if (head.bit) {
+                points = (points + 15) & ~15;
+            }
+            if (merged) {
+                blocks.back().points = points;
+            }
+            else {
+                blocks.push_back({ head, points });
+            }
+            polled.push_back(t);
+            placement.push_back({ Source::Block, t.device.bit, blocks.size() - 1,
+                t.device.number - blocks.back().headdevice.number });
+        }
+    }
+
+    // After the PLC refused a 0x0406: read each block-placed tag on its own, so only the
+    // tags it refuses by themselves are left out, and point 'placement' at the new result
+    static MCProtocol::BlockReadResult readEachAlone(MCProtocol& plc, const std::vector<Tag>& polled,
+        std::vector<Placement>& placement, std::vector<std::pair<uint64_t, MCProtocol::PlcError>>& refused)
+    {
+        MCProtocol::BlockReadResult all;
+        for (size_t i = 0; i < polled.size(); ++i) {
+            if (placement[i].source != Source::Block) {
+                continue;
+            }
+            std::vector<Tag> one{ polled[i] };
+            std::vector<MCProtocol::BlockRequest> wordBlocks;
+            std::vector<MCProtocol::BlockRequest> bitBlocks;
+            std::vector<Tag> packed;
+            std::vector<Placement> alone;
+            packBlocks(one, wordBlocks, bitBlocks, packed, alone);
+            try {
+                MCProtocol::BlockReadResult r = plc.read_blocks(wordBlocks, bitBlocks);
+                placement[i] = alone.front();
+                if (alone.front().bit) {
+                    all.bits.push_back(std::move(r.bits.front()));
+                    placement[i].block = all.bits.size() - 1;
+                }
+                else {
+                    all.words.push_back(std::move(r.words.front()));
+                    placement[i].block = all.words.size() - 1;
+                }
+            }
+            catch (const MCProtocol::PlcError& ex) {
+                refused.emplace_back(polled[i].serial, ex);
+            }
+        }
+        return all;
+    }
+
+    // 1 s, doubling up to 30 s
+    static std::chrono::milliseconds refusedRetryDelay(int refusals) {
+        return std::chrono::milliseconds(std::min(kRefusedRetryMaxMs, kRefusedRetryMs << std::min(refusals - 1, 5)));
+    }
+
+    static int32_t monitorValue(const MCProtocol::RandomReadResult& monitor, const Placement& p, int point) {
+        int pos = p.offset + point;
+        size_t entry = static_cast<size_t>(p.bit ? pos / 16 : pos);
+        if (entry >= monitor.words.size()) {
+            return 0;
+        }
+        if (!p.bit) {
+            return monitor.words[entry];
+        }
+        return (static_cast<uint16_t>(monitor.words[entry]) >> (pos % 16)) & 1;
+    }
+
+    static int32_t blockValue(const MCProtocol::BlockReadResult& result, const Placement& p, int point) {
+        size_t pos = static_cast<size_t>(p.offset + point);
+        return p.bit ? result.bits[p.block][pos] : result.words[p.block][pos];
+    }
+
+    Tag* findTag(int id) {
+        auto it = std::find_if(tags.begin(), tags.end(), [id](const Tag& t) { return t.slot == id; });
+        return it == tags.end() ? nullptr : &*it;
+    }
+
+    void noteChange(Tag& tag, int point, int32_t value, bool baseline, std::vector<Change>& changes) {
+        if (!baseline) {
+            int32_t last = tag.reported[point];
+            if (value == last) {
+                return;
+            }
+            if (!tag.device.bit && std::abs(value - last) < tag.deadband) {
+                return;
+            }
+        }
+        changes.push_back({ tag.slot, tag.slot + point, value, tag.reported[point] });
+        tag.reported[point] = value;
+    }
+
+    // First-fit run of 'points' free slots, or -1
+    int findFreeSlots(int points) const {
+        std::vector<bool> used(PlcTagImage::kCapacity, false);
+        for (const Tag& t : tags) {
+            std::fill(used.begin() + t.slot, used.begin() + t.slot + t.points, true);
+        }
+        int run = 0;
+        for (int i = 0; i < PlcTagImage::kCapacity; ++i) {
+            run = used[i] ? 0 : run + 1;
+            if (run == points) {
+                return i - points + 1;
+            }
+        }
+        return -1;
+    }
+
+    int usedSlots() const {
+        int end = 0;
+        for (const Tag& t : tags) {
+            end = std::max(end, t.slot + t.points);
+        }
+        return end;
+    }
+
+    Clock::time_point nextDue(Clock::time_point now) const {
+        Clock::time_point next = now + std::chrono::milliseconds(kMaxPeriodMs);
+        for (const Tag& t : tags) {
+            next = std::min(next, t.next);
+        }
+        return next;
+    }
+};
+
+#endif // PLCPOLLSCHEDULER_H
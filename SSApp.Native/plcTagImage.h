@@ -0,0 +1,81 @@
+#ifndef PLCTAGIMAGE_H
+#define PLCTAGIMAGE_H
+
+#include <atomic>
+#include <cstdint>
+#include <algorithm>
+#include <thread>
+
+// Latest polled PLC values, written by one thread (the poller) and read by any number
+// of threads without a lock. Published with a seqlock: the writer makes the sequence
+// odd, stores the values, then makes it even again; a reader copies the values and
+// retries if the sequence was odd or moved meanwhile, so every snapshot is one poll.
+class PlcTagImage {
+public:
+    static constexpr int kCapacity = 1024;
+
+    // --- Writer side (single thread) ---
+    void beginUpdate() {
+        sequence.store(sequence.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+    }
+
+    void set(int index, int32_t value) {
+        if (index >= 0 && index < kCapacity) {
+            values[index].store(value, std::memory_order_relaxed);
+        }
+    }
+
+    void setCount(int count) {
+        tagCount.store(std::clamp(count, 0, kCapacity), std::memory_order_relaxed);
+    }
+
+    void endUpdate() {
+        sequence.store(sequence.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    // --- Reader side ---
+    // Copies up to maxCount values into 'out' and returns how many tags the image holds
+    // (may exceed maxCount). 'version' counts completed updates.
+    int snapshot(int32_t* out, int maxCount, uint32_t* version = nullptr) const {
+        while (true) {
+            uint32_t before = sequence.load(std::memory_order_acquire);
+            if (before & 1) {
+                std::this_thread::yield(); // writer mid-update; it only stores a few KB
+                continue;
+            }
+            int count = tagCount.load(std::memory_order_relaxed);
+            int n = std::min(count, std::max(maxCount, 0));
+            for (int i = 0; i < n; ++i) {
+                out[i] = values[i].load(std::memory_order_relaxed);
+            }
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (sequence.load(std::memory_order_relaxed) == before) {
+                if (version) {
+                    *version = before / 2;
+                }
+                return count;
+            }
+        }
+    }
+
+    // Completed updates so far; moves whenever a poll has published something
+    uint32_t version() const {
+        return sequence.load(std::memory_order_acquire) / 2;
+    }
+
+    // A single slot is one atomic load and needs no retry
+    int32_t get(int index) const {
+        if (index < 0 || index >= kCapacity) {
+            return 0;
+        }
+        return values[index].load(std::memory_order_relaxed);
+    }
+
+private:
+    alignas(64) std::atomic<uint32_t> sequence{ 0 };
+    std::atomic<int> tagCount{ 0 };
+    alignas(64) std::atomic<int32_t> values[kCapacity]; // value-initialized (0) since C++20
+};
+
+#endif // PLCTAGIMAGE_H
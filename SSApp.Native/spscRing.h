@@ -0,0 +1,93 @@
+#ifndef SPSCRING_H
+#define SPSCRING_H
+
+#include <atomic>
+#include <memory>
+#include <cstddef>
+#include <cstdint>
+
+// Bounded single-producer / single-consumer queue. push() never blocks or allocates: it
+// fails when the ring is full, so the producer (the SDK's grab thread) can count the
+// drop and move on. The consumer sleeps in wait() until a push or close().
+template <typename T>
+class SpscRing {
+public:
+    explicit SpscRing(size_t capacity) : limit(capacity > 0 ? capacity : 1) {
+        size_t size = 1;
+        while (size < limit) {
+            size <<= 1;
+        }
+        slots = std::make_unique<T[]>(size);
+        mask = size - 1;
+    }
+
+    SpscRing(const SpscRing&) = delete;
+    SpscRing& operator=(const SpscRing&) = delete;
+
+    // Producer only
+    bool push(T&& value) {
+        size_t tail = tail_index.load(std::memory_order_relaxed);
+        if (tail - head_index.load(std::memory_order_acquire) >= limit) {
+            return false;
+        }
+        slots[tail & mask] = std::move(value);
+        tail_index.store(tail + 1, std::memory_order_release);
+        signal();
+        return true;
+    }
+
+    // Consumer only. The slot is cleared, so a moved-from shared_ptr or the like lets go
+    // of its object here rather than when the slot is next reused.
+    bool pop(T& out) {
+        size_t head = head_index.load(std::memory_order_relaxed);
+        if (head == tail_index.load(std::memory_order_acquire)) {
+            return false;
+        }
+        out = std::move(slots[head & mask]);
+        slots[head & mask] = T();
+        head_index.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer only: returns once the ring is not empty or closed
+    void wait() {
+        uint32_t seen = signals.load(std::memory_order_acquire);
+        if (closed.load(std::memory_order_acquire)
+            || head_index.load(std::memory_order_relaxed) != tail_index.load(std::memory_order_acquire)) {
+            return;
+        }
+        signals.wait(seen, std::memory_order_acquire);
+    }
+
+    // Releases the consumer from wait(), now and from then on, so it can see it should stop
+    void close() {
+        closed.store(true, std::memory_order_release);
+        signal();
+    }
+
+    size_t capacity() const {
+        return limit;
+    }
+
+    size_t size() const {
+        return tail_index.load(std::memory_order_acquire) - head_index.load(std::memory_order_acquire);
+    }
+
+private:
+    std::unique_ptr<T[]> slots; // power-of-two sized, so indices wrap with a mask
+    size_t mask = 0;
+    size_t limit;
+
+    // Each index on its own cache line: the producer writes one, the consumer the other
+    alignas(64) std::atomic<size_t> head_index{ 0 };
+    alignas(64) std::atomic<size_t> tail_index{ 0 };
+    alignas(64) std::atomic<uint32_t> signals{ 0 };
+    std::atomic<bool> closed{ false };
+
+    void signal() {
+        signals.fetch_add(1, std::memory_order_release);
+        signals.notify_one();
+    }
+};
+
+#endif // SPSCRING_H
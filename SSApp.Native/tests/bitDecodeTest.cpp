@@ -0,0 +1,179 @@
+// Bit read decoding: the kBitDigits decoder (decodeBitResponse, read_bit and its span overload)
+// against the old stringstream parser, kept here as the reference. Exit code 1 on any difference.
+//
+//   bitDecodeTest [replies]                 offline: random replies through both decoders
+//   bitDecodeTest --simulator [host port]   also reads bits from plc_simulator.py (all ON)
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <random>
+#include <span>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "testAccess.h"
+
+using Access = MCProtocolTestAccess;
+
+// MCProtocol::parseBitResponse before the nibble table: print the data like Python's
+// str(binary_answer[11:]) and keep every '0'/'1' character
+static std::vector<int> referenceParseBitResponse(const std::vector<uint8_t>& buffer, int count) {
+    std::vector<int> result;
+
+    if (buffer.size() <= 11) {
+        // No data
+        result.assign(count, 0);
+        return result;
+    }
+
+    // Build string like Python's str(binary_answer[11:])
+    std::stringstream ss;
+    ss << "b'";
+    for (size_t i = 11; i < buffer.size(); ++i) {
+        ss << "\\x"
+            << std::hex << std::nouppercase
+            << std::setw(2) << std::setfill('0')
+            << static_cast<int>(buffer[i]);
+    }
+    ss << "'";
+
+    std::string dataStr = ss.str();
+
+    std::vector<int> binDigits;
+    binDigits.reserve(dataStr.size());
+    for (char c : dataStr) {
+        if (c == '0') {
+            binDigits.push_back(0);
+        }
+        else if (c == '1') {
+            binDigits.push_back(1);
+        }
+    }
+
+    for (int i = 0; i < count && i < static_cast<int>(binDigits.size()); ++i) {
+        result.push_back(binDigits[i]);
+    }
+
+    // If fewer bits than requested, pad with 0 like a safe default
+    while (static_cast<int>(result.size()) < count) {
+        result.push_back(0);
+    }
+
+    return result;
+}
+
+static void dump(const char* label, const std::vector<uint8_t>& bytes) {
+    std::printf("  %-8s", label);
+    for (uint8_t b : bytes) {
+        std::printf("%02x", b);
+    }
+    std::printf("\n");
+}
+
+// Both decoder entry points against the reference for one reply
+static bool check(const std::vector<uint8_t>& reply, int count) {
+    std::vector<int> expected = referenceParseBitResponse(reply, count);
+    std::vector<int> parsed = Access::parseBitResponse(reply, count);
+    std::vector<uint8_t> span(count, 0xCC);
+    Access::decodeBitResponse(reply, span.data(), span.size());
+
+    bool ok = parsed == expected && std::equal(span.begin(), span.end(), expected.begin(), expected.end());
+    if (!ok) {
+        std::printf("MISMATCH count %d\n", count);
+        dump("reply", reply);
+        dump("expected", std::vector<uint8_t>(expected.begin(), expected.end()));
+        dump("vector", std::vector<uint8_t>(parsed.begin(), parsed.end()));
+        dump("span", span);
+    }
+    return ok;
+}
+
+static bool compareRandomReplies(int replies) {
+    std::mt19937 rng(20240611);
+    auto below = [&](int n) { return static_cast<int>(rng() % static_cast<unsigned>(n)); };
+
+    int failures = 0;
+    for (int r = 0; r < replies && failures < 10; ++r) {
+        int count = below(200) + 1;
+        int dataBytes = (count + 1) / 2;
+        std::vector<uint8_t> reply(11, 0);
+        reply[0] = 0xD0;
+
+        switch (r % 4) {
+        case 0: // what a PLC sends: one nibble (0 or 1) per point
+            for (int i = 0; i < dataBytes; ++i) {
+                reply.push_back(static_cast<uint8_t>((below(2) << 4) | below(2)));
+            }
+            break;
+        case 1: // arbitrary bytes: nibbles above 1 are not points
+            for (int i = 0, n = below(2 * dataBytes + 4); i < n; ++i) {
+                reply.push_back(static_cast<uint8_t>(below(256)));
+            }
+            break;
+        case 2: // truncated well-formed reply
+            for (int i = 0, n = below(dataBytes + 1); i < n; ++i) {
+                reply.push_back(static_cast<uint8_t>((below(2) << 4) | below(2)));
+            }
+            break;
+        default: // header only, or shorter
+            reply.resize(below(12));
+            break;
+        }
+
+        if (!check(reply, count)) {
+            ++failures;
+        }
+        // Asking for more or fewer points than the reply carries
+        if (!check(reply, below(260))) {
+            ++failures;
+        }
+    }
+    return failures == 0;
+}
+
+// read_bit and read_bit(span) over TCP: the simulator answers every bit read with all points ON
+static bool checkSimulator(const char* host, int port) {
+    MCProtocol plc;
+    if (!plc.connect(host, port)) {
+        std::printf("cannot connect to %s:%d\n", host, port);
+        return false;
+    }
+
+    bool ok = true;
+    for (int length : { 1, 2, 7, 64, 255 }) {
+        std::vector<int> bits = plc.read_bit("M100", length);
+        std::vector<uint8_t> span(length, 0xCC);
+        size_t read = plc.read_bit("X20", std::span<uint8_t>(span));
+
+        bool allOn = static_cast<int>(bits.size()) == length && read == span.size();
+        for (int i = 0; i < length; ++i) {
+            allOn = allOn && bits[i] == 1 && span[i] == 1;
+        }
+        if (!allOn) {
+            std::printf("simulator read_bit x%d: expected all ON\n", length);
+            ok = false;
+        }
+    }
+    plc.disconnect();
+    return ok;
+}
+
+int main(int argc, char** argv) {
+    bool simulator = argc > 1 && std::strcmp(argv[1], "--simulator") == 0;
+    int replies = (!simulator && argc > 1) ? std::atoi(argv[1]) : 200000;
+
+    bool ok = compareRandomReplies(replies);
+    std::printf("%d random replies: %s\n", replies, ok ? "identical" : "DIFFERENT");
+
+    if (simulator) {
+        const char* host = argc > 2 ? argv[2] : "127.0.0.1";
+        int port = argc > 3 ? std::atoi(argv[3]) : 6000;
+        bool simOk = checkSimulator(host, port);
+        std::printf("simulator %s:%d: %s\n", host, port, simOk ? "all ON" : "FAILED");
+        ok = ok && simOk;
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,301 @@
+// The camera-side helpers that need no camera: FramePool (against the SDK buffer stub in
+// mvSdkStub.cpp), SpscRing, ImageWriterPool's overflow policies and WriteMonoTiff16.
+// Exit code 1 on any failure.
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <future>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "cameraFramePool.h"
+#include "imageWriter.h"
+#include "spscRing.h"
+#include "tiffWriter.h"
+#include "mvSdkStub.h"
+
+using namespace std::chrono;
+
+static bool expect(bool condition, const char* what) {
+    if (!condition) {
+        std::printf("FAILED: %s\n", what);
+    }
+    return condition;
+}
+
+static bool framePool() {
+    int handleTarget = 0;
+    void* handle = &handleTarget;
+    bool ok = true;
+    {
+        FramePool pool;
+        ok &= expect(!pool.reserve(0, 4096, 4), "reserve of size 0 fails");
+        ok &= expect(pool.reserve(1000, 4096, 4), "reserve");
+        ok &= expect(pool.capacity() == 4 && pool.bufferSize() == 1000, "reserve sizes the pool");
+        ok &= expect(MvSdkStub::allocated == 4 && MvSdkStub::lastAlignment == 4096, "reserve allocates aligned");
+
+        ok &= expect(pool.reserve(800, 4096, 4) && MvSdkStub::allocated == 4 && pool.bufferSize() == 1000,
+            "buffers that fit are kept");
+
+        ok &= expect(pool.registerWith(handle, 3) == 3 && MvSdkStub::registered == 3, "registerWith");
+        ok &= expect(!pool.reserve(2000, 4096, 4), "no reserve while the SDK holds the buffers");
+        pool.unregisterFrom(handle);
+        ok &= expect(MvSdkStub::registered == 0, "unregisterFrom");
+
+        ok &= expect(pool.reserve(2000, 4096, 4) && pool.bufferSize() == 2000 && MvSdkStub::allocated == 4,
+            "larger reserve reallocates");
+
+        MvSdkStub::registerLimit = 2;
+        ok &= expect(pool.registerWith(handle, 4) == 2, "registerWith counts only the buffers that took");
+        MvSdkStub::registerLimit = -1;
+        pool.unregisterFrom(handle);
+    }
+    ok &= expect(MvSdkStub::allocated == 0, "destructor frees the buffers");
+
+    {
+        FramePool pool;
+        pool.reserve(1000, 64, 2);
+        pool.registerWith(handle, 2);
+        pool.abandon();
+        ok &= expect(pool.capacity() == 0 && pool.bufferSize() == 0, "abandon empties the pool");
+    }
+    ok &= expect(MvSdkStub::allocated == 2 && MvSdkStub::registered == 2, "abandoned buffers stay with the SDK");
+    MvSdkStub::releaseAll();
+    return ok;
+}
+
+static bool spscRing() {
+    bool ok = true;
+    SpscRing<int> ring(5);
+    ok &= expect(ring.capacity() == 5, "capacity is the requested one, not the slot count");
+    for (int i = 0; i < 5; ++i) {
+        ok &= expect(ring.push(int(i)), "push below capacity");
+    }
+    ok &= expect(!ring.push(5) && ring.size() == 5, "push on a full ring fails");
+
+    int value = -1;
+    for (int i = 0; i < 5; ++i) {
+        ok &= expect(ring.pop(value) && value == i, "pop in push order");
+    }
+    ok &= expect(!ring.pop(value) && ring.size() == 0, "pop on an empty ring fails");
+
+    // pop() clears the slot, so nothing outlives its consumer in the ring
+    SpscRing<std::shared_ptr<int>> held(2);
+    auto object = std::make_shared<int>(7);
+    std::weak_ptr<int> watch = object;
+    held.push(std::move(object));
+    {
+        std::shared_ptr<int> taken;
+        ok &= expect(held.pop(taken) && taken && *taken == 7, "pop a shared_ptr");
+    }
+    ok &= expect(watch.expired(), "popped slot lets go of its object");
+
+    // Threaded: every value arrives once, in order, through a ring far smaller than the run
+    const int count = 100000;
+    SpscRing<int> channel(16);
+    std::thread producer([&] {
+        for (int i = 0; i < count; ++i) {
+            while (!channel.push(int(i))) {
+                std::this_thread::yield();
+            }
+        }
+        channel.close();
+    });
+    int expected = 0;
+    bool ordered = true;
+    while (true) {
+        int got;
+        if (channel.pop(got)) {
+            ordered &= got == expected++;
+            continue;
+        }
+        if (expected == count) {
+            break;
+        }
+        channel.wait();
+    }
+    producer.join();
+    ok &= expect(ordered && expected == count, "threaded values arrive in order");
+
+    // close() releases a waiting consumer
+    SpscRing<int> idle(4);
+    std::thread closer([&] {
+        std::this_thread::sleep_for(milliseconds(50));
+        idle.close();
+    });
+    idle.wait();
+    closer.join();
+    idle.wait(); // and every wait from then on
+    return ok;
+}
+
+// One writer held busy by a job that waits on 'release', so the queue behind it fills
+struct BusyWriter {
+    std::promise<void> started;
+    std::promise<void> release;
+    std::shared_future<void> released = release.get_future().share();
+    std::future<bool> busy;
+
+    explicit BusyWriter(ImageWriterPool& pool) {
+        busy = pool.submit([this] {
+            started.set_value();
+            released.wait();
+            return true;
+        });
+        started.get_future().wait();
+    }
+};
+
+static bool writerReject() {
+    bool ok = true;
+    ImageWriterPool pool(1, 2, ImageWriterPool::Overflow::Reject, milliseconds(0));
+    BusyWriter writer(pool);
+    std::future<bool> first = pool.submit([] { return true; });
+    std::future<bool> second = pool.submit([] { return true; });
+    std::future<bool> third = pool.submit([] { return true; });
+    ok &= expect(first.valid() && second.valid(), "Reject queues up to the depth");
+    ok &= expect(!third.valid() && pool.rejected() == 1, "Reject turns away a job on a full queue");
+    writer.release.set_value();
+    ok &= expect(pool.waitIdle(seconds(5)), "waitIdle");
+    ok &= expect(writer.busy.get() && first.get() && second.get(), "queued jobs are written");
+    return ok;
+}
+
+static bool writerBlock() {
+    bool ok = true;
+    ImageWriterPool pool(1, 1, ImageWriterPool::Overflow::Block, milliseconds(200));
+    BusyWriter writer(pool);
+    std::future<bool> queued = pool.submit([] { return true; });
+
+    auto start = steady_clock::now();
+    std::future<bool> late = pool.submit([] { return true; });
+    auto waited = duration_cast<milliseconds>(steady_clock::now() - start).count();
+    ok &= expect(!late.valid() && pool.rejected() == 1, "Block rejects after blockTimeout");
+    ok &= expect(waited >= 150 && waited < 3000, "Block waits out blockTimeout");
+
+    // Room made while the submitter waits lets it in
+    std::thread releaser([&] {
+        std::this_thread::sleep_for(milliseconds(50));
+        writer.release.set_value();
+    });
+    std::future<bool> admitted = pool.submit([] { return true; });
+    releaser.join();
+    ok &= expect(admitted.valid() && pool.rejected() == 1, "Block admits a job once there is room");
+    ok &= expect(pool.waitIdle(seconds(5)), "waitIdle");
+    ok &= expect(queued.get() && admitted.get(), "queued jobs are written");
+    return ok;
+}
+
+static bool writerDropOldest() {
+    bool ok = true;
+    ImageWriterPool pool(1, 2, ImageWriterPool::Overflow::DropOldest, milliseconds(0));
+    BusyWriter writer(pool);
+    std::future<bool> oldest = pool.submit([] { return true; });
+    std::future<bool> middle = pool.submit([] { return true; });
+    std::future<bool> newest = pool.submit([] { return true; });
+    ok &= expect(newest.valid() && pool.dropped() == 1 && pool.rejected() == 0, "DropOldest queues the new job");
+    ok &= expect(oldest.wait_for(seconds(0)) == std::future_status::ready && !oldest.get(),
+        "dropped job resolves to false");
+    writer.release.set_value();
+    ok &= expect(pool.waitIdle(seconds(5)) && pool.pending() == 0, "waitIdle");
+    ok &= expect(middle.get() && newest.get(), "the jobs kept are written");
+    return ok;
+}
+
+static uint16_t le16(const std::vector<uint8_t>& file, size_t at) {
+    return static_cast<uint16_t>(file[at] | (file[at + 1] << 8));
+}
+
+static uint32_t le32(const std::vector<uint8_t>& file, size_t at) {
+    return le16(file, at) | (static_cast<uint32_t>(le16(file, at + 2)) << 16);
+}
+
+// Value of a one-count IFD entry (SHORT or LONG); ~0 when the tag is missing
+static uint32_t tiffTag(const std::vector<uint8_t>& file, uint16_t tag) {
+    uint32_t ifd = le32(file, 4);
+    uint16_t entries = le16(file, ifd);
+    for (uint16_t i = 0; i < entries; ++i) {
+        size_t entry = ifd + 2 + i * 12;
+        if (le16(file, entry) == tag) {
+            return le16(file, entry + 2) == 3 ? le16(file, entry + 8) : le32(file, entry + 8);
+        }
+    }
+    return ~0u;
+}
+
+static bool monoTiff() {
+    bool ok = true;
+    ok &= expect(MonoTiffBits(PixelType_Gvsp_Mono10) == 10 && MonoTiffBits(PixelType_Gvsp_Mono12) == 12
+        && MonoTiffBits(PixelType_Gvsp_Mono12_Packed) == 12 && MonoTiffBits(PixelType_Gvsp_Mono16) == 16
+        && MonoTiffBits(PixelType_Gvsp_Mono8) == 0, "MonoTiffBits");
+
+    // Odd pixel count, so the last packed group holds a single pixel
+    const unsigned int width = 5, height = 3, pixels = width * height;
+    std::vector<uint16_t> values(pixels);
+    for (unsigned int i = 0; i < pixels; ++i) {
+        values[i] = static_cast<uint16_t>((i * 273 + 17) & 0xFFF);
+    }
+    std::vector<unsigned char> packed((pixels * 3 + 1) / 2);
+    for (unsigned int i = 0; i < pixels; i += 2) {
+        uint16_t a = values[i];
+        uint16_t b = i + 1 < pixels ? values[i + 1] : 0;
+        unsigned char* group = packed.data() + (i / 2) * 3;
+        group[0] = static_cast<unsigned char>(a >> 4);
+        group[1] = static_cast<unsigned char>((a & 0x0F) | ((b & 0x0F) << 4));
+        if (i + 1 < pixels) {
+            group[2] = static_cast<unsigned char>(b >> 4);
+        }
+    }
+
+    std::string path = (std::filesystem::temp_directory_path() / "cameraHelpersTest.tif").string();
+    ok &= expect(!WriteMonoTiff16(path, packed.data(), static_cast<unsigned int>(packed.size() - 1),
+        width, height, PixelType_Gvsp_Mono12_Packed), "short Mono12Packed buffer is refused");
+    ok &= expect(!WriteMonoTiff16(path, packed.data(), static_cast<unsigned int>(packed.size()),
+        width, height, PixelType_Gvsp_Mono8), "non-mono16 format is refused");
+    if (!expect(WriteMonoTiff16(path, packed.data(), static_cast<unsigned int>(packed.size()),
+        width, height, PixelType_Gvsp_Mono12_Packed), "write Mono12Packed")) {
+        return false;
+    }
+
+    std::ifstream in(path, std::ios::binary);
+    std::vector<uint8_t> file((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    in.close();
+    std::filesystem::remove(path);
+    if (!expect(file.size() > 8 && file[0] == 'I' && file[1] == 'I' && le16(file, 2) == 42 && le32(file, 4) == 8,
+        "little-endian TIFF header")) {
+        return false;
+    }
+    ok &= expect(le16(file, 8) == 14, "IFD entry count");
+    ok &= expect(tiffTag(file, 256) == width && tiffTag(file, 257) == height, "image size");
+    ok &= expect(tiffTag(file, 258) == 16, "16 bits per sample");
+    ok &= expect(tiffTag(file, 279) == pixels * 2, "StripByteCounts");
+    ok &= expect(tiffTag(file, 281) == 4095, "MaxSampleValue for 12 bits");
+
+    uint32_t strip = tiffTag(file, 273);
+    if (!expect(strip != ~0u && strip + pixels * 2 == file.size(), "strip ends the file")) {
+        return false;
+    }
+    bool samples = true;
+    for (unsigned int i = 0; i < pixels; ++i) {
+        samples &= le16(file, strip + i * 2) == values[i];
+    }
+    ok &= expect(samples, "strip samples match the packed pixels");
+    return ok;
+}
+
+int main() {
+    bool ok = true;
+    ok &= framePool();
+    ok &= spscRing();
+    ok &= writerReject();
+    ok &= writerBlock();
+    ok &= writerDropOldest();
+    ok &= monoTiff();
+    std::printf("camera helpers: %s\n", ok ? "ok" : "FAILED");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,123 @@
+// Request encoding: RequestBuffer (MCProtocol) against the old vector/map path (legacyEncoder.h).
+// First checks both produce the same bytes, then times each. Exit code 1 on any mismatch.
+//
+//   encodeBench [frames]
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "legacyEncoder.h"
+#include "testAccess.h"
+
+using Access = MCProtocolTestAccess;
+
+static std::vector<uint8_t> bytesOf(const Access::RequestBuffer& frame) {
+    return std::vector<uint8_t>(frame.bytes, frame.bytes + frame.size);
+}
+
+static void dump(const char* label, const std::vector<uint8_t>& bytes) {
+    std::printf("  %-6s", label);
+    for (uint8_t b : bytes) {
+        std::printf("%02x", b);
+    }
+    std::printf("\n");
+}
+
+static bool same(const char* what, const std::vector<uint8_t>& legacy, const std::vector<uint8_t>& current) {
+    if (legacy == current) {
+        return true;
+    }
+    std::printf("MISMATCH %s\n", what);
+    dump("old", legacy);
+    dump("new", current);
+    return false;
+}
+
+static bool compareFrames(const LegacyEncoder& legacy) {
+    bool ok = true;
+    Access::RequestBuffer frame;
+
+    const char* readDevices[] = { "D100", "d0", "M8191", "X17", "Y177", "B1A0", "W7FF", "R32767", "L5", "F3" };
+    for (const char* device : readDevices) {
+        for (int length : { 1, 10, 960 }) {
+            std::string what = std::string("read ") + device + " x" + std::to_string(length);
+            Access::encodeRequest(frame, Access::Frame::ReadWord, device, length);
+            ok &= same(what.c_str(), legacy.constructPacket(device, length, "read_word", {}), bytesOf(frame));
+            Access::encodeRequest(frame, Access::Frame::ReadBit, device, length);
+            ok &= same(("bit " + what).c_str(), legacy.constructPacket(device, length, "read_bit", {}), bytesOf(frame));
+        }
+    }
+
+    const std::vector<std::vector<int>> bitSets = { { 1 }, { 0, 1 }, { 1, 0, 1, 1, 0 }, std::vector<int>(257, 1) };
+    for (const std::vector<int>& bits : bitSets) {
+        std::string what = "write_bit X17 x" + std::to_string(bits.size());
+        Access::encodeWriteBits(frame, "X17", bits);
+        ok &= same(what.c_str(),
+            legacy.constructPacket("X17", static_cast<int>(bits.size()), "write_bit", LegacyEncoder::encodeBitData(bits)),
+            bytesOf(frame));
+    }
+
+    const std::vector<std::vector<int16_t>> wordSets = { { 1 }, { 1, -2, 300 }, std::vector<int16_t>(480, -32768) };
+    for (const std::vector<int16_t>& words : wordSets) {
+        std::string what = "write_word W1A0 x" + std::to_string(words.size());
+        Access::encodeWriteWords(frame, "W1A0", words);
+        ok &= same(what.c_str(),
+            legacy.constructPacket("W1A0", static_cast<int>(words.size()), "write_word", LegacyEncoder::encodeWordData(words)),
+            bytesOf(frame));
+    }
+    return ok;
+}
+
+template <typename Encode>
+static double nsPerFrame(int frames, Encode encode) {
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < frames; ++i) {
+        encode();
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    return std::chrono::duration<double, std::nano>(elapsed).count() / frames;
+}
+
+int main(int argc, char** argv) {
+    int frames = argc > 1 ? std::atoi(argv[1]) : 2000000;
+    if (frames <= 0) {
+        frames = 1;
+    }
+
+    LegacyEncoder legacy;
+    if (!compareFrames(legacy)) {
+        return 1;
+    }
+    std::printf("frames identical\n");
+
+    // Devices as runtime strings, the way the exports receive them
+    const std::string readDevice = "D100";
+    const std::string bitDevice = "Y10";
+    const std::vector<int> bits = { 1, 0, 1, 1, 0 };
+    volatile size_t sink = 0;
+
+    double oldRead = nsPerFrame(frames, [&] {
+        sink = sink + legacy.constructPacket(readDevice, 10, "read_word", {}).size();
+    });
+    double newRead = nsPerFrame(frames, [&] {
+        Access::RequestBuffer frame;
+        Access::encodeRequest(frame, Access::Frame::ReadWord, readDevice, 10);
+        sink = sink + frame.size;
+    });
+    double oldWrite = nsPerFrame(frames, [&] {
+        sink = sink + legacy.constructPacket(bitDevice, 5, "write_bit", LegacyEncoder::encodeBitData(bits)).size();
+    });
+    double newWrite = nsPerFrame(frames, [&] {
+        Access::RequestBuffer frame;
+        Access::encodeWriteBits(frame, bitDevice, bits);
+        sink = sink + frame.size;
+    });
+
+    std::printf("%d frames each, ns/frame   old      new\n", frames);
+    std::printf("  read_word D100 x10     %7.1f  %7.1f\n", oldRead, newRead);
+    std::printf("  write_bit Y10 x5       %7.1f  %7.1f\n", oldWrite, newWrite);
+    return 0;
+}
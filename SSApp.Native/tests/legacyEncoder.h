@@ -0,0 +1,162 @@
+#ifndef LEGACYENCODER_H
+#define LEGACYENCODER_H
+
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// MCProtocol's request encoder as it was before RequestBuffer: a template vector copied
+// out of a std::map, device parsed with substr + std::stoi, payload built in temporaries.
+// Kept only as the reference the encode benchmark compares against, byte for byte.
+class LegacyEncoder {
+public:
+    LegacyEncoder() {
+        device_map["M"] = { 0x90, 10 };
+        device_map["L"] = { 0x92, 10 };
+        device_map["F"] = { 0x93, 10 };
+        device_map["D"] = { 0xA8, 10 };
+        device_map["R"] = { 0xAF, 10 };
+        device_map["B"] = { 0xA0, 16 };
+        device_map["W"] = { 0xB4, 16 };
+        device_map["X"] = { 0x9C, 8 };
+        device_map["Y"] = { 0x9D, 8 };
+
+        base_packets["read_word"] = { 0x50,0x00,0x00,0xFF,0xFF,0x03,0x00,0x0C,0x00,0x00,0x00,0x01,0x04,0x00,0x00 };
+        base_packets["read_bit"] = { 0x50,0x00,0x00,0xFF,0xFF,0x03,0x00,0x0C,0x00,0x00,0x00,0x01,0x04,0x01,0x00 };
+        base_packets["write_bit"] = { 0x50,0x00,0x00,0xFF,0xFF,0x03,0x00,0x0C,0x00,0x00,0x00,0x01,0x14,0x01,0x00 };
+        base_packets["write_word"] = { 0x50,0x00,0x00,0xFF,0xFF,0x03,0x00,0x0C,0x00,0x00,0x00,0x01,0x14,0x00,0x00 };
+    }
+
+    std::vector<uint8_t> constructPacket(const std::string& headdevice,
+        int length,
+        const std::string& type,
+        const std::vector<uint8_t>& writeData) const
+    {
+        auto baseIt = base_packets.find(type);
+        if (baseIt == base_packets.end()) {
+            throw std::invalid_argument("Unknown packet type: " + type);
+        }
+
+        std::vector<uint8_t> packet = baseIt->second;
+
+        appendDevice(packet, headdevice);
+
+        // Append Length (number of points) (2 bytes little-endian)
+        packet.push_back(static_cast<uint8_t>(length & 0xFF));
+        packet.push_back(static_cast<uint8_t>((length >> 8) & 0xFF));
+
+        // Append Write Data if any
+        if (!writeData.empty()) {
+            packet.insert(packet.end(), writeData.begin(), writeData.end());
+
+            // Python only patches length for writes (data_list != b"")
+            patchRequestLength(packet);
+        }
+
+        return packet;
+    }
+
+    // Nibble-per-point payload for bit writes
+    static std::vector<uint8_t> encodeBitData(const std::vector<int>& data) {
+        int length = static_cast<int>(data.size());
+
+        // Replicate Python logic WITHOUT big-int limit:
+        // if len is odd -> add one '0' nibble at the end
+        std::vector<int> hexDigits;
+        hexDigits.reserve(length + 1);
+        for (int v : data) {
+            hexDigits.push_back(v ? 1 : 0);
+        }
+        if (length % 2 != 0) {
+            hexDigits.push_back(0);
+        }
+
+        int byteLength = static_cast<int>(hexDigits.size()) / 2;
+        std::vector<uint8_t> byteData;
+        byteData.reserve(byteLength);
+
+        // Left-to-right mapping of hex digits to bytes (big-endian style)
+        // Each pair of digits -> one byte: high nibble, low nibble
+        for (int i = 0; i < byteLength; ++i) {
+            int hi = hexDigits[2 * i];
+            int lo = hexDigits[2 * i + 1];
+            uint8_t b = static_cast<uint8_t>(((hi & 0x0F) << 4) | (lo & 0x0F));
+            byteData.push_back(b);
+        }
+
+        return byteData;
+    }
+
+    static std::vector<uint8_t> encodeWordData(const std::vector<int16_t>& data) {
+        std::vector<uint8_t> byteData;
+        byteData.reserve(data.size() * 2);
+        for (int16_t val : data) {
+            byteData.push_back(static_cast<uint8_t>(val & 0xFF));
+            byteData.push_back(static_cast<uint8_t>((val >> 8) & 0xFF));
+        }
+        return byteData;
+    }
+
+private:
+    struct DeviceInfo {
+        uint8_t code;
+        int base; // 8, 10, 16
+    };
+
+    std::map<std::string, DeviceInfo> device_map;
+    std::map<std::string, std::vector<uint8_t>> base_packets;
+
+    // Resolve "D100"/"X17" into start number + device code
+    const DeviceInfo& resolveDevice(const std::string& headdevice, int& addr) const {
+        std::string devTypeStr = headdevice.substr(0, 1);
+        std::transform(devTypeStr.begin(), devTypeStr.end(), devTypeStr.begin(),
+            [](unsigned char c) { return static_cast<char>(std::toupper(c)); });
+
+        auto devIt = device_map.find(devTypeStr);
+        if (devIt == device_map.end()) {
+            throw std::invalid_argument("Invalid device type: " + devTypeStr);
+        }
+        const DeviceInfo& info = devIt->second;
+
+        // Python send_full_data_byte uses headdevice[1:6] (max 5 chars)
+        std::string addrStr;
+        if (headdevice.size() > 1) {
+            size_t maxLen = std::min(static_cast<size_t>(5), headdevice.size() - 1);
+            addrStr = headdevice.substr(1, maxLen);
+        }
+        else {
+            throw std::invalid_argument("No address after device in headdevice: " + headdevice);
+        }
+
+        try {
+            addr = std::stoi(addrStr, nullptr, info.base);
+        }
+        catch (...) {
+            throw std::invalid_argument("Invalid address format: " + headdevice);
+        }
+        return info;
+    }
+
+    // Append Start Number (3 bytes little-endian) + Device Code
+    void appendDevice(std::vector<uint8_t>& packet, const std::string& headdevice) const {
+        int addr = 0;
+        const DeviceInfo& info = resolveDevice(headdevice, addr);
+        packet.push_back(static_cast<uint8_t>(addr & 0xFF));
+        packet.push_back(static_cast<uint8_t>((addr >> 8) & 0xFF));
+        packet.push_back(static_cast<uint8_t>((addr >> 16) & 0xFF));
+        packet.push_back(info.code);
+    }
+
+    // Request data length = everything after the 9-byte header
+    static void patchRequestLength(std::vector<uint8_t>& packet) {
+        int requestLen = static_cast<int>(packet.size()) - 9;
+        packet[7] = static_cast<uint8_t>(requestLen & 0xFF);
+        packet[8] = static_cast<uint8_t>((requestLen >> 8) & 0xFF);
+    }
+};
+
+#endif // LEGACYENCODER_H
@@ -0,0 +1,90 @@
+// Stand-ins for the MVS SDK buffer calls (see mvSdkStub.h). On Windows this is built with
+// MV_CAMCTRL_EXPORTS, so the SDK header declares them for export instead of import.
+
+#include <cstdlib>
+#include <set>
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+#include "MvCameraControl.h"
+#include "mvSdkStub.h"
+
+int MvSdkStub::allocated = 0;
+int MvSdkStub::registered = 0;
+int MvSdkStub::registerLimit = -1;
+unsigned int MvSdkStub::lastAlignment = 0;
+
+#ifdef _WIN32
+static void* alignedAlloc(size_t alignment, size_t size) { return _aligned_malloc(size, alignment); }
+static void alignedFree(void* buffer) { _aligned_free(buffer); }
+#else
+static void* alignedAlloc(size_t alignment, size_t size) { return std::aligned_alloc(alignment, size); }
+static void alignedFree(void* buffer) { std::free(buffer); }
+#endif
+
+static std::set<void*>& liveBuffers() {
+    static std::set<void*> buffers;
+    return buffers;
+}
+
+static std::set<void*>& registeredBuffers() {
+    static std::set<void*> buffers;
+    return buffers;
+}
+
+void MvSdkStub::releaseAll() {
+    for (void* buffer : liveBuffers()) {
+        alignedFree(buffer);
+    }
+    liveBuffers().clear();
+    registeredBuffers().clear();
+    allocated = 0;
+    registered = 0;
+}
+
+void* __stdcall MV_CC_AllocAlignedBuffer(uint64_t nBufSize, unsigned int nAlignment) {
+    if (nAlignment == 0 || (nAlignment & (nAlignment - 1)) != 0) {
+        return nullptr;
+    }
+    // aligned_alloc wants the size in whole alignment units
+    uint64_t size = (nBufSize + nAlignment - 1) / nAlignment * nAlignment;
+    void* buffer = alignedAlloc(nAlignment, static_cast<size_t>(size));
+    if (buffer) {
+        liveBuffers().insert(buffer);
+        ++MvSdkStub::allocated;
+        MvSdkStub::lastAlignment = nAlignment;
+    }
+    return buffer;
+}
+
+int __stdcall MV_CC_FreeAlignedBuffer(void* pBuffer) {
+    if (liveBuffers().erase(pBuffer) == 0) {
+        return MV_E_PARAMETER;
+    }
+    if (registeredBuffers().count(pBuffer) != 0) {
+        std::abort(); // freeing a buffer the SDK still uses as a grab node
+    }
+    alignedFree(pBuffer);
+    --MvSdkStub::allocated;
+    return MV_OK;
+}
+
+int __stdcall MV_CC_RegisterBuffer(void* handle, void* pBuffer, uint64_t /*nBufSize*/, void* /*pUser*/) {
+    if (!handle || liveBuffers().count(pBuffer) == 0 ||
+        (MvSdkStub::registerLimit >= 0 && MvSdkStub::registered >= MvSdkStub::registerLimit)) {
+        return MV_E_PARAMETER;
+    }
+    if (registeredBuffers().insert(pBuffer).second) {
+        ++MvSdkStub::registered;
+    }
+    return MV_OK;
+}
+
+int __stdcall MV_CC_UnRegisterBuffer(void* /*handle*/, void* pBuffer) {
+    if (registeredBuffers().erase(pBuffer) == 0) {
+        return MV_E_PARAMETER;
+    }
+    --MvSdkStub::registered;
+    return MV_OK;
+}
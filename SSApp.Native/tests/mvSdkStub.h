@@ -0,0 +1,16 @@
+#ifndef MVSDKSTUB_H
+#define MVSDKSTUB_H
+
+// The few MVS SDK buffer calls FramePool makes, faked in mvSdkStub.cpp so the camera-side
+// helpers build and run without the SDK or a camera. Tests read and steer it through here.
+struct MvSdkStub {
+    static int allocated;            // MV_CC_AllocAlignedBuffer buffers not yet freed
+    static int registered;           // MV_CC_RegisterBuffer buffers not yet unregistered
+    static int registerLimit;        // MV_CC_RegisterBuffer fails beyond this many (-1 = no limit)
+    static unsigned int lastAlignment;
+
+    // Frees whatever is still allocated (buffers a test abandoned on purpose)
+    static void releaseAll();
+};
+
+#endif // MVSDKSTUB_H
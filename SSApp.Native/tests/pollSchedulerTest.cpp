@@ -0,0 +1,327 @@
+// PlcPollScheduler and PlcTagImage. Offline: block packing (overlapping, adjacent and
+// separate tags, bit tags aligned to words) and the image's seqlock under a busy writer.
+// Against plc_simulator.py: which tags each poll reads, deadband and change batching
+// (plain D devices read back random values), and bit tags that don't start on a word
+// boundary, in blocks and in the monitor (word access to bit devices follows the
+// simulator's test pattern: ON when the device number is a multiple of 3, and is refused
+// unless it starts on a multiple of 16), and a tag the PLC refuses. Exit code 1 on any failure.
+//
+//   pollSchedulerTest [host port]
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "testAccess.h"
+
+using namespace std::chrono;
+using Access = PlcPollSchedulerTestAccess;
+using Clock = PlcPollScheduler::Clock;
+
+static bool expect(bool condition, const char* what) {
+    if (!condition) {
+        std::printf("FAILED: %s\n", what);
+    }
+    return condition;
+}
+
+static bool isBlock(const MCProtocol::BlockRequest& block, const char* head, int points) {
+    MCProtocol::DeviceAddress expected(head);
+    return block.headdevice.code == expected.code && block.headdevice.number == expected.number &&
+        block.points == points;
+}
+
+static int32_t patternBit(int number) {
+    return number % 3 == 0 ? 1 : 0;
+}
+
+static bool blockPacking() {
+    Access::Packed packed = Access::packBlocks({
+        { "D102", 4 }, // overlaps D100
+        { "D100", 4 },
+        { "D106", 2 }, // starts where D102's range ends
+        { "D110", 1 }, // gap after D107: own block
+        { "W10", 2 },  // other device: own block
+        { "M5", 4 },   // bit tags: word-aligned head, whole words
+        { "M20", 3 },  // next word touches the M0 block's end
+        { "M70", 1 },
+    });
+
+    bool ok = expect(packed.wordBlocks.size() == 3 && packed.bitBlocks.size() == 2, "block count");
+    if (!ok) {
+        return false;
+    }
+    ok &= expect(isBlock(packed.wordBlocks[0], "D100", 8), "overlapping and adjacent tags share a block");
+    ok &= expect(isBlock(packed.wordBlocks[1], "D110", 1), "tag after a gap starts a block");
+    ok &= expect(isBlock(packed.wordBlocks[2], "W10", 2), "other device starts a block");
+    ok &= expect(isBlock(packed.bitBlocks[0], "M0", 32), "bit block aligned down and rounded up");
+    ok &= expect(isBlock(packed.bitBlocks[1], "M64", 16), "separate bit block aligned down");
+
+    const std::pair<size_t, int> expected[] = {
+        { 0, 2 }, { 0, 0 }, { 0, 6 }, { 1, 0 }, { 2, 0 }, { 0, 5 }, { 0, 20 }, { 1, 6 },
+    };
+    for (size_t i = 0; i < std::size(expected); ++i) {
+        ok &= expect(packed.placement[i] == expected[i], "tag placement in its block");
+    }
+    return ok;
+}
+
+// Every snapshot a reader gets is one whole update: the writer stores its update number in
+// every slot, so all values must match each other and the snapshot's version
+static bool seqlock() {
+    constexpr int kSlots = 256;
+    constexpr uint32_t kUpdates = 100000;
+    PlcTagImage image;
+    std::atomic<bool> done{ false };
+    std::atomic<int> torn{ 0 };
+    std::atomic<int> backwards{ 0 };
+
+    auto reader = [&] {
+        std::vector<int32_t> values(kSlots);
+        uint32_t last = 0;
+        while (!done) {
+            uint32_t version = 0;
+            int count = image.snapshot(values.data(), kSlots, &version);
+            if (version < last) {
+                ++backwards;
+            }
+            last = version;
+            for (int i = 0; i < count; ++i) {
+                if (values[i] != static_cast<int32_t>(version)) {
+                    ++torn;
+                    break;
+                }
+            }
+        }
+    };
+    std::thread readers[] = { std::thread(reader), std::thread(reader) };
+
+    for (uint32_t update = 1; update <= kUpdates; ++update) {
+        image.beginUpdate();
+        for (int i = 0; i < kSlots; ++i) {
+            image.set(i, static_cast<int32_t>(update));
+        }
+        image.setCount(kSlots);
+        image.endUpdate();
+    }
+    done = true;
+    for (std::thread& t : readers) {
+        t.join();
+    }
+
+    bool ok = expect(torn == 0, "snapshots hold one update each");
+    ok &= expect(backwards == 0, "snapshot versions never go back");
+    ok &= expect(image.version() == kUpdates, "version counts updates");
+    return ok;
+}
+
+// A 50 ms tag is read every 50 ms and a 300 ms one only when it is due; a poll with nothing
+// due reads nothing. Both tags are watched with deadband 0, so a read shows up as a change
+// (four random points all repeating is too unlikely to matter).
+static bool dueSelection(MCProtocol& plc) {
+    PlcTagImage image;
+    PlcPollScheduler scheduler(image);
+    int fast = scheduler.addTag("D100", 4, 50);
+    int slow = scheduler.addTag("D200", 4, 300);
+    scheduler.watch(fast, 0);
+    scheduler.watch(slow, 0);
+    std::map<int, int> reads;
+    scheduler.setChangeListener([&](const std::vector<PlcPollScheduler::Change>& changes) {
+        std::set<int> tags;
+        for (const PlcPollScheduler::Change& c : changes) {
+            tags.insert(c.tagId);
+        }
+        for (int tag : tags) {
+            ++reads[tag];
+        }
+    });
+
+    Clock::time_point start = Clock::now();
+    Clock::time_point next = scheduler.poll(plc);
+    bool ok = expect(next > start && next <= start + milliseconds(60), "next due is the fast tag");
+
+    uint32_t version = image.version();
+    ok &= expect(scheduler.poll(plc) == next && image.version() == version, "nothing due, nothing read");
+
+    while (Clock::now() < start + milliseconds(640)) {
+        std::this_thread::sleep_until(next);
+        next = scheduler.poll(plc);
+    }
+    std::printf("due selection: fast read %d times, slow %d times in 640 ms\n", reads[fast], reads[slow]);
+    ok &= expect(reads[fast] >= 8 && reads[fast] <= 14, "50 ms tag read every 50 ms");
+    ok &= expect(reads[slow] >= 2 && reads[slow] <= 3, "300 ms tag read only when due");
+    return ok;
+}
+
+// All changes from one poll arrive in one call; the first poll after watch() reports every
+// slot as a baseline; later a slot is reported only once it has moved at least the deadband
+// away from the value last reported for it.
+static bool changeBatching(MCProtocol& plc) {
+    PlcTagImage image;
+    PlcPollScheduler scheduler(image);
+    int anyChange = scheduler.addTag("D300", 8, 20);
+    int banded = scheduler.addTag("D400", 8, 20);
+    scheduler.watch(anyChange, 0);
+    scheduler.watch(banded, 50);
+
+    std::vector<std::vector<PlcPollScheduler::Change>> calls;
+    scheduler.setChangeListener([&](const std::vector<PlcPollScheduler::Change>& changes) {
+        calls.push_back(changes);
+    });
+
+    const int polls = 30;
+    for (int i = 0; i < polls; ++i) {
+        std::this_thread::sleep_until(scheduler.poll(plc));
+    }
+
+    bool ok = expect(!calls.empty() && calls.size() <= polls, "one listener call per poll at most");
+    if (!ok) {
+        return false;
+    }
+    ok &= expect(calls.front().size() == 16, "baseline reports every slot");
+    for (const PlcPollScheduler::Change& c : calls.front()) {
+        ok &= expect(c.previous == 0, "baseline previous is 0");
+    }
+
+    std::map<int, int32_t> reported;
+    bool bothInOneCall = false;
+    for (size_t call = 0; call < calls.size(); ++call) {
+        std::set<int> tags;
+        for (const PlcPollScheduler::Change& c : calls[call]) {
+            tags.insert(c.tagId);
+            if (call > 0) {
+                ok &= expect(c.previous == reported[c.slot], "previous is the value last reported");
+                ok &= expect(c.value != c.previous, "only changes are reported");
+                if (c.tagId == banded) {
+                    ok &= expect(std::abs(c.value - c.previous) >= 50, "deadband holds back small moves");
+                }
+            }
+            reported[c.slot] = c.value;
+        }
+        bothInOneCall |= call > 0 && tags.size() == 2;
+    }
+    ok &= expect(bothInOneCall, "changes of both tags batched in one call");
+    return ok;
+}
+
+// Bit tags that don't start on a word boundary (M5, X17) are read from a block aligned
+// down to it, and each tag's values are picked out at its offset into the block
+static bool unalignedBitTags(MCProtocol& plc) {
+    PlcTagImage image;
+    PlcPollScheduler scheduler(image);
+    // The fastest tag becomes the monitor group; the bit tags go out as 0x0406 blocks
+    scheduler.addTag("D7000", 1, 10);
+    int m5 = scheduler.addTag("M5", 4, 20);
+    int x17 = scheduler.addTag("X17", 3, 20); // octal: X15..X17 decimal, across a word boundary
+
+    bool ok = true;
+    try {
+        scheduler.poll(plc);
+    }
+    catch (const std::exception& ex) {
+        std::printf("poll: %s\n", ex.what());
+        return expect(false, "poll with unaligned bit tags");
+    }
+    for (int k = 0; k < 4; ++k) {
+        ok &= expect(image.get(m5 + k) == patternBit(5 + k), "M5 tag values");
+    }
+    for (int k = 0; k < 3; ++k) {
+        ok &= expect(image.get(x17 + k) == patternBit(15 + k), "X17 tag values");
+    }
+    return ok;
+}
+
+// The same bit tags in the monitor group: each registers the 16-aligned words its bits
+// touch, and its values are picked out at its offset into the first of them
+static bool monitorBitTags(MCProtocol& plc) {
+    PlcTagImage image;
+    PlcPollScheduler scheduler(image);
+    int m5 = scheduler.addTag("M5", 4, 10);
+    int x17 = scheduler.addTag("X17", 3, 10);
+    int d = scheduler.addTag("D7000", 2, 10);
+    int m30 = scheduler.addTag("M30", 20, 10); // M30..M49: three entries
+
+    bool ok = true;
+    try {
+        scheduler.poll(plc);
+    }
+    catch (const std::exception& ex) {
+        std::printf("poll: %s\n", ex.what());
+        return expect(false, "poll with unaligned bit tags in the monitor");
+    }
+    ok &= expect(plc.monitorId() != 0, "PLC accepted the monitor registration");
+    for (int k = 0; k < 4; ++k) {
+        ok &= expect(image.get(m5 + k) == patternBit(5 + k), "M5 monitor values");
+    }
+    for (int k = 0; k < 3; ++k) {
+        ok &= expect(image.get(x17 + k) == patternBit(15 + k), "X17 monitor values");
+    }
+    for (int k = 0; k < 2; ++k) {
+        ok &= expect(image.get(d + k) == 7000 + k, "word monitor values after bit tags");
+    }
+    for (int k = 0; k < 20; ++k) {
+        ok &= expect(image.get(m30 + k) == patternBit(30 + k), "M30 monitor values");
+    }
+    return ok;
+}
+
+// A tag the PLC refuses (the simulator refuses blocks on D7999) is found by reading the
+// batch tag by tag, reported once and backed off; the tags read with it still update
+static bool refusedTag(MCProtocol& plc) {
+    PlcTagImage image;
+    PlcPollScheduler scheduler(image);
+    scheduler.addTag("D100", 1, 10); // monitor group
+    int before = scheduler.addTag("D7990", 2, 50);
+    int refused = scheduler.addTag("D7999", 1, 50);
+    int after = scheduler.addTag("D7000", 2, 50);
+
+    bool ok = true;
+    try {
+        Clock::time_point start = Clock::now();
+        scheduler.poll(plc);
+        std::vector<PlcPollScheduler::Refusal> first = scheduler.takeRefusals();
+        ok &= expect(first.size() == 1 && first[0].tagId == refused && first[0].endCode == 0xC056,
+            "refused tag reported");
+        ok &= expect(image.get(before) == 7990 && image.get(before + 1) == 7991 &&
+            image.get(after) == 7000 && image.get(after + 1) == 7001, "tags read with a refused one update");
+
+        // Poll on for a while: the refused tag stays backed off and is not reported again
+        while (Clock::now() < start + milliseconds(1500)) {
+            std::this_thread::sleep_until(scheduler.poll(plc));
+        }
+        ok &= expect(scheduler.takeRefusals().empty(), "refusal reported once");
+    }
+    catch (const std::exception& ex) {
+        std::printf("poll: %s\n", ex.what());
+        return expect(false, "poll with a refused tag");
+    }
+    return ok;
+}
+
+int main(int argc, char** argv) {
+    std::string host = argc > 1 ? argv[1] : "127.0.0.1";
+    int port = argc > 2 ? std::atoi(argv[2]) : 6000;
+
+    bool ok = blockPacking();
+    ok &= seqlock();
+
+    MCProtocol plc;
+    if (!plc.connect(host, port)) {
+        std::printf("cannot connect to %s:%d\n", host.c_str(), port);
+        return 1;
+    }
+    ok &= dueSelection(plc);
+    ok &= changeBatching(plc);
+    ok &= unalignedBitTags(plc);
+    ok &= monitorBitTags(plc);
+    ok &= refusedTag(plc);
+    plc.disconnect();
+    std::printf("poll scheduler %s:%d: %s\n", host.c_str(), port, ok ? "ok" : "FAILED");
+    return ok ? 0 : 1;
+}
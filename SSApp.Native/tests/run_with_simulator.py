@@ -0,0 +1,51 @@
+"""Run a test command against plc_simulator.py.
+
+    python run_with_simulator.py <plc_simulator.py> <command> [args...]
+
+Starts the simulator, waits until it accepts connections on 127.0.0.1:6000, runs the
+command and returns its exit code. A simulator that is already listening is used as is.
+"""
+import socket
+import subprocess
+import sys
+import time
+
+HOST = '127.0.0.1'
+PORT = 6000
+
+
+def listening():
+    try:
+        with socket.create_connection((HOST, PORT), timeout=0.2):
+            return True
+    except OSError:
+        return False
+
+
+def main():
+    if len(sys.argv) < 3:
+        print(__doc__)
+        return 2
+
+    simulator = None
+    if not listening():
+        simulator = subprocess.Popen([sys.executable, sys.argv[1]],
+                                     stdout=subprocess.DEVNULL, stderr=subprocess.DEVNULL)
+        deadline = time.monotonic() + 10
+        while not listening():
+            if simulator.poll() is not None or time.monotonic() > deadline:
+                print(f"plc_simulator did not start listening on {HOST}:{PORT}")
+                simulator.kill()
+                return 1
+            time.sleep(0.1)
+
+    try:
+        return subprocess.call(sys.argv[2:])
+    finally:
+        if simulator is not None:
+            simulator.kill()
+            simulator.wait()
+
+
+if __name__ == '__main__':
+    sys.exit(main())
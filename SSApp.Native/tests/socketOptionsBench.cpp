@@ -0,0 +1,92 @@
+// Per-write latency for each SocketOptions variant against plc_simulator.py (or a PLC):
+// 3E blocking write_bit pairs, then 4E attached pairs submitted back to back, the way a
+// scan step sets two outputs. Prints mean/p50/p99 per write; exit code 1 if anything fails.
+//
+//   socketOptionsBench [writes] [host port]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "mcProtocol.h"
+
+using namespace std::chrono;
+
+struct Variant {
+    const char* name;
+    MCProtocol::SocketOptions options;
+};
+
+static bool run(const Variant& variant, bool attached, MCEventLoop& loop,
+    const std::string& host, int port, int pairs) {
+    MCProtocol plc;
+    if (attached) {
+        plc.setFrameType(MCProtocol::FrameType::E4);
+        plc.attach(loop);
+    }
+    if (!plc.connect(host, port, variant.options)) {
+        std::printf("%-28s connect to %s:%d failed\n", variant.name, host.c_str(), port);
+        return false;
+    }
+
+    std::vector<double> perWriteUs;
+    perWriteUs.reserve(pairs);
+    bool ok = true;
+    for (int i = 0; i < pairs && ok; ++i) {
+        auto start = steady_clock::now();
+        if (attached) {
+            // Both requests in flight before waiting on either
+            std::future<bool> first = plc.submit_write_bit("Y1", { 1 });
+            std::future<bool> second = plc.submit_write_bit("Y2", { 0 });
+            ok = first.get() && second.get();
+        }
+        else {
+            ok = plc.write_bit("Y1", { i & 1 }) && plc.write_bit("Y2", { i & 1 });
+        }
+        perWriteUs.push_back(duration<double, std::micro>(steady_clock::now() - start).count() / 2);
+    }
+    plc.disconnect();
+    if (!ok) {
+        std::printf("%-28s write failed\n", variant.name);
+        return false;
+    }
+
+    std::sort(perWriteUs.begin(), perWriteUs.end());
+    double sum = 0;
+    for (double us : perWriteUs) {
+        sum += us;
+    }
+    size_t n = perWriteUs.size();
+    std::printf("%-28s mean %8.1f us  p50 %8.1f  p99 %8.1f\n", variant.name,
+        sum / n, perWriteUs[n / 2], perWriteUs[std::min(n - 1, n * 99 / 100)]);
+    return true;
+}
+
+int main(int argc, char** argv) {
+    int pairs = argc > 1 ? std::max(1, std::atoi(argv[1])) : 400;
+    std::string host = argc > 2 ? argv[2] : "127.0.0.1";
+    int port = argc > 3 ? std::atoi(argv[3]) : 6000;
+
+    std::vector<Variant> variants(4);
+    variants[0].name = "noDelay=1 (default)";
+    variants[1].name = "noDelay=0 (Nagle)";
+    variants[1].options.noDelay = false;
+    variants[2].name = "noDelay=1, 256 KB buffers";
+    variants[2].options.sendBufferBytes = 256 * 1024;
+    variants[2].options.receiveBufferBytes = 256 * 1024;
+    variants[3].name = "noDelay=1, keepAlive=0";
+    variants[3].options.keepAlive = false;
+
+    MCEventLoop loop;
+    bool ok = true;
+    for (bool attached : { false, true }) {
+        std::printf(attached ? "-- 4E pipelined pair (submit x2) --\n" : "-- 3E blocking write_bit x2 --\n");
+        for (const Variant& variant : variants) {
+            ok &= run(variant, attached, loop, host, port, pairs);
+        }
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,72 @@
+#ifndef TESTACCESS_H
+#define TESTACCESS_H
+
+#include "mcProtocol.h"
+#include "plcPollScheduler.h"
+
+// The parts of MCProtocol the tests and benchmarks measure directly, mostly without a socket
+struct MCProtocolTestAccess {
+    using RequestBuffer = MCProtocol::RequestBuffer;
+    using Frame = MCProtocol::Frame;
+    using DeviceAddress = MCProtocol::DeviceAddress;
+
+    static void encodeRequest(RequestBuffer& out, Frame kind, const DeviceAddress& headdevice, int length) {
+        MCProtocol::encodeRequest(out, kind, headdevice, length);
+    }
+
+    static void encodeWriteBits(RequestBuffer& out, const DeviceAddress& headdevice, const std::vector<int>& data) {
+        MCProtocol::encodeWriteBits(out, headdevice, data);
+    }
+
+    static void encodeWriteWords(RequestBuffer& out, const DeviceAddress& headdevice, const std::vector<int16_t>& data) {
+        MCProtocol::encodeWriteWords(out, headdevice, data);
+    }
+
+    static std::vector<int> parseBitResponse(const std::vector<uint8_t>& buffer, int count) {
+        return MCProtocol::parseBitResponse(buffer, count);
+    }
+
+    // 4E replies read off the socket but not yet claimed by their future
+    static size_t parkedReplies(const MCProtocol& plc) {
+        return plc.parked_replies.size();
+    }
+
+    template <typename T>
+    static void decodeBitResponse(const std::vector<uint8_t>& buffer, T* out, size_t count) {
+        MCProtocol::decodeBitResponse(buffer, out, count);
+    }
+};
+
+// PlcPollScheduler's block packing, without a PLC
+struct PlcPollSchedulerTestAccess {
+    using BlockRequest = MCProtocol::BlockRequest;
+
+    struct Packed {
+        std::vector<BlockRequest> wordBlocks;
+        std::vector<BlockRequest> bitBlocks;
+        std::vector<std::pair<size_t, int>> placement; // per tag, in argument order: block, offset
+    };
+
+    // Packs one tag per (headdevice, points) as if they were all due in the same tick
+    static Packed packBlocks(const std::vector<std::pair<MCProtocol::DeviceAddress, int>>& tags) {
+        std::vector<PlcPollScheduler::Tag> due;
+        for (size_t i = 0; i < tags.size(); ++i) {
+            PlcPollScheduler::Tag tag;
+            tag.device = tags[i].first;
+            tag.points = tags[i].second;
+            tag.serial = i;
+            due.push_back(tag);
+        }
+        Packed packed;
+        std::vector<PlcPollScheduler::Tag> polled;
+        std::vector<PlcPollScheduler::Placement> placement;
+        PlcPollScheduler::packBlocks(due, packed.wordBlocks, packed.bitBlocks, polled, placement);
+        packed.placement.resize(tags.size());
+        for (size_t i = 0; i < polled.size(); ++i) {
+            packed.placement[polled[i].serial] = { placement[i].block, placement[i].offset };
+        }
+        return packed;
+    }
+};
+
+#endif // TESTACCESS_H
@@ -0,0 +1,229 @@
+// Transport paths against plc_simulator.py's test devices: word reads from D7000 up return
+// their own addresses, reads headed at D7500+ are answered late and D7999 is never answered.
+// Exit code 1 on any failure.
+//
+//   transportTest [host port]         4E pipelined bursts (unattached and on the event loop)
+//                                     and response timeouts
+//   transportTest --udp [host port]   UDP reads from a simulator that drops requests (start
+//                                     it with SIM_UDP_DROP set); they must be resent
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <future>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "testAccess.h"
+
+using namespace std::chrono;
+using Access = MCProtocolTestAccess;
+
+static MCProtocol::DeviceAddress testDevice(int number) {
+    return std::string("D") + std::to_string(number);
+}
+
+// The simulator answers a test read with the address of each point
+static bool echoes(const std::vector<int16_t>& words, int head, int length) {
+    if (static_cast<int>(words.size()) != length) {
+        return false;
+    }
+    for (int i = 0; i < length; ++i) {
+        if (words[i] != static_cast<int16_t>(head + i)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool expect(bool condition, const char* what) {
+    if (!condition) {
+        std::printf("FAILED: %s\n", what);
+    }
+    return condition;
+}
+
+// Unattached 4E: the late reply is claimed first, so the replies that overtake it on the
+// wire have to be parked under their serials until their own futures ask for them
+static bool burstUnattached(const std::string& host, int port) {
+    MCProtocol plc;
+    plc.setFrameType(MCProtocol::FrameType::E4);
+    if (!expect(plc.connect(host, port), "4E connect")) {
+        return false;
+    }
+
+    std::future<std::vector<int16_t>> late = plc.submit_read_sign_word(testDevice(7500), 4);
+    std::vector<std::future<std::vector<int16_t>>> early;
+    for (int i = 0; i < 6; ++i) {
+        early.push_back(plc.submit_read_sign_word(testDevice(7000 + i * 10), i + 1));
+    }
+
+    bool ok = expect(echoes(late.get(), 7500, 4), "late 4E reply matches its request");
+    ok &= expect(Access::parkedReplies(plc) == early.size(), "overtaking replies parked");
+    for (int i = 0; i < 6; ++i) {
+        ok &= expect(echoes(early[i].get(), 7000 + i * 10, i + 1), "parked 4E reply matches its request");
+    }
+    ok &= expect(Access::parkedReplies(plc) == 0, "parked replies claimed");
+    plc.disconnect();
+    return ok;
+}
+
+// Attached 4E: the loop completes replies in arrival order, whatever the send order
+static bool burstAttached(MCEventLoop& loop, const std::string& host, int port) {
+    MCProtocol plc;
+    plc.setFrameType(MCProtocol::FrameType::E4);
+    plc.attach(loop);
+    if (!expect(plc.connect(host, port), "attached 4E connect")) {
+        return false;
+    }
+
+    const int heads[] = { 7500, 7000, 7010, 7020, 7030, 7040, 7050 };
+    const int count = static_cast<int>(std::size(heads));
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::vector<int> order;
+    bool ok = true;
+    for (int i = 0; i < count; ++i) {
+        int head = heads[i];
+        plc.async_read_sign_word(testDevice(head), 3,
+            [&, i, head](std::vector<int16_t> words, std::exception_ptr error) {
+                std::lock_guard<std::mutex> lock(mutex);
+                ok &= expect(!error && echoes(words, head, 3), "attached 4E reply matches its request");
+                order.push_back(i);
+                cv.notify_one();
+            });
+    }
+
+    std::unique_lock<std::mutex> lock(mutex);
+    bool done = cv.wait_for(lock, seconds(5), [&] { return static_cast<int>(order.size()) == count; });
+    ok &= expect(done, "attached burst completes");
+    ok &= expect(done && order.back() == 0, "late reply completes after the ones sent behind it");
+    lock.unlock();
+    plc.disconnect();
+    return ok;
+}
+
+// A request that is never answered fails the whole channel after responseTimeoutMs; the
+// request answered behind it on the same 4E channel still completes
+static bool timeoutAttached(MCEventLoop& loop, const std::string& host, int port) {
+    MCProtocol::SocketOptions options;
+    options.responseTimeoutMs = 300;
+    MCProtocol plc;
+    plc.setFrameType(MCProtocol::FrameType::E4);
+    plc.attach(loop);
+    if (!expect(plc.connect(host, port, options), "attached connect for timeout")) {
+        return false;
+    }
+
+    auto start = steady_clock::now();
+    std::future<std::vector<int16_t>> silent = plc.async_read_sign_word(testDevice(7999), 1);
+    std::future<std::vector<int16_t>> answered = plc.async_read_sign_word(testDevice(7000), 2);
+
+    bool ok = expect(echoes(answered.get(), 7000, 2), "reply behind a silent request");
+    bool timedOut = false;
+    try {
+        silent.get();
+    }
+    catch (const std::exception& ex) {
+        timedOut = std::strstr(ex.what(), "timeout") != nullptr;
+    }
+    auto waited = duration_cast<milliseconds>(steady_clock::now() - start).count();
+    ok &= expect(timedOut, "silent request fails with a timeout");
+    ok &= expect(waited >= 250 && waited < 3000, "timeout after responseTimeoutMs");
+    ok &= expect(!plc.isConnected(), "timed-out channel is failed");
+
+    bool refused = false;
+    try {
+        plc.read_sign_word(testDevice(7000), 1);
+    }
+    catch (const std::exception&) {
+        refused = true;
+    }
+    ok &= expect(refused, "failed channel refuses new requests");
+    plc.disconnect();
+    return ok;
+}
+
+// Unattached 3E: SO_RCVTIMEO ends the blocking read
+static bool timeoutUnattached(const std::string& host, int port) {
+    MCProtocol::SocketOptions options;
+    options.responseTimeoutMs = 300;
+    MCProtocol plc;
+    if (!expect(plc.connect(host, port, options), "connect for timeout")) {
+        return false;
+    }
+
+    auto start = steady_clock::now();
+    bool threw = false;
+    try {
+        plc.read_sign_word(testDevice(7999), 1);
+    }
+    catch (const std::exception&) {
+        threw = true;
+    }
+    auto waited = duration_cast<milliseconds>(steady_clock::now() - start).count();
+    plc.disconnect();
+    return expect(threw, "unanswered 3E read throws") &
+        expect(waited >= 250 && waited < 3000, "3E timeout after responseTimeoutMs");
+}
+
+// UDP through a lossy simulator: every read must still succeed, and at least one must have
+// waited out a response timeout - i.e. been resent
+static bool udpResend(MCEventLoop& loop, bool attached, const std::string& host, int port) {
+    MCProtocol::SocketOptions options;
+    options.transport = MCProtocol::Transport::UDP;
+    options.responseTimeoutMs = 100;
+    options.udpRetries = 10;
+    MCProtocol plc;
+    if (attached) {
+        plc.attach(loop);
+    }
+    if (!expect(plc.connect(host, port, options), "UDP connect")) {
+        return false;
+    }
+
+    const char* label = attached ? "attached UDP" : "UDP";
+    bool ok = true;
+    int resent = 0;
+    for (int i = 0; i < 30 && ok; ++i) {
+        auto start = steady_clock::now();
+        try {
+            ok = expect(echoes(plc.read_sign_word(testDevice(7000 + i), 2), 7000 + i, 2), "UDP reply matches its request");
+        }
+        catch (const std::exception& ex) {
+            std::printf("%s read %d: %s\n", label, i, ex.what());
+            ok = false;
+        }
+        if (steady_clock::now() - start >= milliseconds(90)) {
+            ++resent;
+        }
+    }
+    plc.disconnect();
+    std::printf("%s: %d of 30 reads resent\n", label, resent);
+    return ok && expect(resent > 0, "a dropped UDP request was resent (is SIM_UDP_DROP set?)");
+}
+
+int main(int argc, char** argv) {
+    bool udp = argc > 1 && std::strcmp(argv[1], "--udp") == 0;
+    int first = udp ? 2 : 1;
+    std::string host = argc > first ? argv[first] : "127.0.0.1";
+    int port = argc > first + 1 ? std::atoi(argv[first + 1]) : 6000;
+
+    MCEventLoop loop;
+    bool ok = true;
+    if (udp) {
+        ok &= udpResend(loop, false, host, port);
+        ok &= udpResend(loop, true, host, port);
+    }
+    else {
+        ok &= burstUnattached(host, port);
+        ok &= burstAttached(loop, host, port);
+        ok &= timeoutAttached(loop, host, port);
+        ok &= timeoutUnattached(host, port);
+    }
+    std::printf("transport %s:%d%s: %s\n", host.c_str(), port, udp ? " (UDP)" : "", ok ? "ok" : "FAILED");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,123 @@
+#ifndef TIFFWRITER_H
+#define TIFFWRITER_H
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "MvCameraControl.h"
+
+// 16-bit grayscale TIFF for the high bit-depth mono formats, which the SDK's savers cut
+// down to 8 bits. Samples keep the camera's values (0-4095 for Mono12, MaxSampleValue
+// says so), uncompressed in a single strip so writing costs no more than a raw dump:
+// unpacked formats go to the file straight from the frame buffer.
+
+// Bits per sample of a mono format written this way, 0 for any other format
+inline unsigned int MonoTiffBits(MvGvspPixelType type) {
+    switch (type) {
+    case PixelType_Gvsp_Mono10:
+        return 10;
+    case PixelType_Gvsp_Mono12:
+    case PixelType_Gvsp_Mono12_Packed:
+        return 12;
+    case PixelType_Gvsp_Mono16:
+        return 16;
+    default:
+        return 0;
+    }
+}
+
+inline bool WriteMonoTiff16(const std::string& path, const unsigned char* data, unsigned int dataLen,
+    unsigned int width, unsigned int height, MvGvspPixelType type) {
+    unsigned int bits = MonoTiffBits(type);
+    uint64_t pixels = static_cast<uint64_t>(width) * height;
+    uint64_t bytes = pixels * 2;
+    if (bits == 0 || !data || pixels == 0 || bytes > UINT32_MAX) {
+        return false;
+    }
+
+    // Mono12Packed: two pixels in three bytes, high 8 bits of each in bytes 0 and 2,
+    // their low 4 bits in the low and high nibble of byte 1
+    std::vector<uint16_t> unpacked;
+    const unsigned char* samples = data;
+    if (type == PixelType_Gvsp_Mono12_Packed) {
+        if (dataLen < (pixels * 3 + 1) / 2) {
+            return false;
+        }
+        unpacked.resize(pixels);
+        for (uint64_t i = 0; i < pixels; ++i) {
+            const unsigned char* group = data + (i / 2) * 3;
+            unpacked[i] = (i & 1)
+                ? static_cast<uint16_t>((group[2] << 4) | (group[1] >> 4))
+                : static_cast<uint16_t>((group[0] << 4) | (group[1] & 0x0F));
+        }
+        samples = reinterpret_cast<const unsigned char*>(unpacked.data());
+    }
+    else if (dataLen < bytes) {
+        return false;
+    }
+
+    // Header, one IFD, the two resolution rationals, then the strip
+    constexpr uint16_t entries = 14;
+    constexpr uint32_t ifdOffset = 8;
+    constexpr uint32_t rationalOffset = ifdOffset + 2 + entries * 12 + 4;
+    constexpr uint32_t stripOffset = rationalOffset + 16;
+
+    std::vector<uint8_t> header;
+    header.reserve(stripOffset);
+    auto put16 = [&](uint32_t v) {
+        header.push_back(static_cast<uint8_t>(v));
+        header.push_back(static_cast<uint8_t>(v >> 8));
+    };
+    auto put32 = [&](uint32_t v) {
+        put16(v & 0xFFFF);
+        put16(v >> 16);
+    };
+    auto entry = [&](uint16_t tag, uint16_t fieldType, uint32_t value) {
+        put16(tag);
+        put16(fieldType);
+        put32(1);
+        if (fieldType == 3) { // SHORT, left-justified in the value field
+            put16(value);
+            put16(0);
+        }
+        else {
+            put32(value);
+        }
+    };
+    constexpr uint16_t kShort = 3, kLong = 4, kRational = 5;
+
+    header.push_back('I');
+    header.push_back('I');
+    put16(42);
+    put32(ifdOffset);
+
+    put16(entries);
+    entry(256, kLong, width);                     // ImageWidth
+    entry(257, kLong, height);                    // ImageLength
+    entry(258, kShort, 16);                       // BitsPerSample
+    entry(259, kShort, 1);                        // Compression: none
+    entry(262, kShort, 1);                        // PhotometricInterpretation: BlackIsZero
+    entry(273, kLong, stripOffset);               // StripOffsets
+    entry(277, kShort, 1);                        // SamplesPerPixel
+    entry(278, kLong, height);                    // RowsPerStrip
+    entry(279, kLong, static_cast<uint32_t>(bytes)); // StripByteCounts
+    entry(281, kShort, (1u << bits) - 1);         // MaxSampleValue
+    entry(282, kRational, rationalOffset);        // XResolution
+    entry(283, kRational, rationalOffset + 8);    // YResolution
+    entry(284, kShort, 1);                        // PlanarConfiguration: chunky
+    entry(296, kShort, 1);                        // ResolutionUnit: none
+    put32(0);                                     // no next IFD
+    for (int i = 0; i < 2; ++i) {
+        put32(1);
+        put32(1);
+    }
+
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file.write(reinterpret_cast<const char*>(header.data()), header.size());
+    file.write(reinterpret_cast<const char*>(samples), static_cast<std::streamsize>(bytes));
+    return static_cast<bool>(file.flush());
+}
+
+#endif // TIFFWRITER_H
@@ -42,14 +42,110 @@ namespace SSApp.UI
         [DllImport("SSApp.Native.dll", CallingConvention = CallingConvention.Cdecl, CharSet = CharSet.Ansi)]
         public static extern void SetPlcBit(string device, int value);
 
+        [DllImport("SSApp.Native.dll", CallingConvention = CallingConvention.Cdecl, CharSet = CharSet.Ansi)]
+        [return: MarshalAs(UnmanagedType.I1)]
+        public static extern bool SetPlcBits(string[] devices, int[] values, int count);
+
+        // Right, Top, Left, Bottom lights; switched together in one PLC write
+        private static readonly string[] LightDevices = { "Y1", "Y3", "Y4", "Y5" };
+
+        private static bool SetLights(bool right, bool top, bool left, bool bottom)
+        {
+            int[] values = { right ? 1 : 0, top ? 1 : 0, left ? 1 : 0, bottom ? 1 : 0 };
+            return SetPlcBits(LightDevices, values, LightDevices.Length);
+        }
+
         [DllImport("SSApp.Native.dll", CallingConvention = CallingConvention.Cdecl, CharSet = CharSet.Ansi)]
         [return: MarshalAs(UnmanagedType.I1)]
         public static extern bool CaptureImageCustom(string filename);
 
+        [StructLayout(LayoutKind.Sequential)]
+        private struct MultiLightScanConfig
+        {
+            public int StepCount;
+            public IntPtr LightMasks;   // int[StepCount]
+            public IntPtr FileNames;    // char*[StepCount]
+            public int LightCount;
+            public IntPtr LightDevices; // char*[LightCount]
+            public int SettleMs;
+            public int FrameTimeoutMs;
+            public IntPtr TriggerDevice; // char*, line trigger only
+        }
+
+        [UnmanagedFunctionPointer(CallingConvention.Cdecl)]
+        private delegate void MultiLightScanCallback(int step, int status, IntPtr fileName);
+
+        [DllImport("SSApp.Native.dll", CallingConvention = CallingConvention.Cdecl)]
+        private static extern int SetCameraTriggerMode(int mode, int line); // 0 = free run, 1 = software, 2 = line
+
+        [DllImport("SSApp.Native.dll", CallingConvention = CallingConvention.Cdecl)]
+        private static extern int RunMultiLightScan(ref MultiLightScanConfig config, MultiLightScanCallback? callback);
+
+        // Light rise time before an exposure counts. The scan software-triggers one exposure
+        // per step after it (or, without trigger support, takes the first frame exposed after
+        // it), so no stale frame is captured
+        private const int ScanSettleMs = 50;
+
+        // Runs the whole scan natively; callback gets (step, status) as each image is saved
+        private static int RunScan(int[] lightMasks, string[] fileNames, MultiLightScanCallback callback)
+        {
+            var pinned = new List<GCHandle>();
+            var strings = new List<IntPtr>();
+            try
+            {
+                IntPtr Pin(object array)
+                {
+                    var handle = GCHandle.Alloc(array, GCHandleType.Pinned);
+                    pinned.Add(handle);
+                    return handle.AddrOfPinnedObject();
+                }
+                IntPtr PinStrings(string[] values)
+                {
+                    var pointers = new IntPtr[values.Length];
+                    for (int i = 0; i < values.Length; i++)
+                    {
+                        pointers[i] = Marshal.StringToHGlobalAnsi(values[i]);
+                        strings.Add(pointers[i]);
+                    }
+                    return Pin(pointers);
+                }
+
+                var config = new MultiLightScanConfig
+                {
+                    StepCount = lightMasks.Length,
+                    LightMasks = Pin(lightMasks),
+                    FileNames = PinStrings(fileNames),
+                    LightCount = LightDevices.Length,
+                    LightDevices = PinStrings(LightDevices),
+                    SettleMs = ScanSettleMs,
+                    FrameTimeoutMs = 0
+                };
+                int saved = RunMultiLightScan(ref config, callback);
+                GC.KeepAlive(callback);
+                return saved;
+            }
+            finally
+            {
+                foreach (var handle in pinned) handle.Free();
+                foreach (var ptr in strings) Marshal.FreeHGlobal(ptr);
+            }
+        }
+
+        [UnmanagedFunctionPointer(CallingConvention.Cdecl)]
+        private delegate void PlcChangeCallback(IntPtr changes, int count);
+
+        [DllImport("SSApp.Native.dll", CallingConvention = CallingConvention.Cdecl)]
+        private static extern void RegisterPlcChangeCallback(PlcChangeCallback? callback);
+
+        [DllImport("SSApp.Native.dll", CallingConvention = CallingConvention.Cdecl)]
+        [return: MarshalAs(UnmanagedType.I1)]
+        private static extern bool WatchPlcTag(int tagId, int deadband);
+
         private bool _isPlcConnected = false;
         private System.Windows.Threading.DispatcherTimer _statusTimer;
         private CameraHost? _cameraHost;
         private bool _isScanRunning = false;
+        private PlcChangeCallback? _plcChangeCallback; // kept referenced while native code may call it
 
         public DashboardWindow()
         {
@@ -63,7 +159,11 @@ namespace SSApp.UI
                      StartLiveView(_cameraHost.Handle, 0);
                 } catch (Exception ex) { Logger.LogError("Camera Init Failed", ex); }
             };
-            this.Closed += (s, e) => StopLiveView();
+            this.Closed += (s, e) =>
+            {
+                StopLiveView();
+                try { RegisterPlcChangeCallback(null); } catch { }
+            };
 
             // Basic display of user + role
             UserInfoText.Text = $"Logged in as {AuthService.CurrentUser ?? "Unknown"}";
@@ -88,6 +188,19 @@ namespace SSApp.UI
                 Logger.LogError("Failed to initialize PLC connection on startup.", ex);
             }
 
+            // Refresh the machine status as soon as D0 (poll tag 0) changes, not on the next tick
+            try
+            {
+                _plcChangeCallback = (changes, count) =>
+                    Dispatcher.BeginInvoke(new Action(() => StatusTimer_Tick(null, EventArgs.Empty)));
+                RegisterPlcChangeCallback(_plcChangeCallback);
+                WatchPlcTag(0, 0);
+            }
+            catch (Exception ex)
+            {
+                Logger.LogError("Failed to register PLC change callback.", ex);
+            }
+
             // Start polling timer
             _statusTimer = new System.Windows.Threading.DispatcherTimer();
             _statusTimer.Interval = TimeSpan.FromMilliseconds(500);
@@ -242,50 +355,45 @@ namespace SSApp.UI
 
             try
             {
-                await Task.Run(async () =>
+                await Task.Run(() =>
                 {
-                    // Sequence: Top(2), Right(1), Bottom(8), Left(4), All(15)
+                    // Sequence: Top(2), Right(1), Bottom(8), Left(4); bit order matches LightDevices
                     int[] scanSequence = { 2, 1, 8, 4 };
+                    string stamp = $"{DateTime.Now:yyyyMMdd_HHmmss}";
 
-                    foreach (int i in scanSequence)
+                    var fileNames = new string[scanSequence.Length];
+                    for (int s = 0; s < scanSequence.Length; s++)
                     {
-                        bool r = (i & 1) != 0;
-                        bool t = (i & 2) != 0;
-                        bool l = (i & 4) != 0;
-                        bool b = (i & 8) != 0;
-
-                        // Set Lights
-                        SetPlcBit("Y1", r ? 1 : 0);
-                        SetPlcBit("Y3", t ? 1 : 0);
-                        SetPlcBit("Y4", l ? 1 : 0);
-                        SetPlcBit("Y5", b ? 1 : 0);
-
-                        // Wait for light adjustment (max 200ms)
-                        await Task.Delay(150);
-
-                        // Generate Filename
+                        int i = scanSequence[s];
                         string filename = "";
-                        if (t) filename += "T";
-                        if (r) filename += "R";
-                        if (b) filename += "B";
-                        if (l) filename += "L";
-                        
-                        // Append timestamp
-                        filename += $"_{DateTime.Now:yyyyMMdd_HHmmss}.jpg";
+                        if ((i & 2) != 0) filename += "T";
+                        if ((i & 1) != 0) filename += "R";
+                        if ((i & 8) != 0) filename += "B";
+                        if ((i & 4) != 0) filename += "L";
+                        fileNames[s] = $"{filename}_{stamp}.jpg";
+                    }
 
-                        // Capture
-                        bool captured = CaptureImageCustom(filename);
-                        if (!captured)
+                    // Native scan switches the lights, captures and saves, then turns the lights off
+                    bool triggered = SetCameraTriggerMode(1, 0) == 0;
+                    int saved;
+                    try
+                    {
+                        saved = RunScan(scanSequence, fileNames, (step, status, _) =>
                         {
-                            Logger.LogError($"Failed to capture {filename}");
-                        }
+                            if (status != 0)
+                            {
+                                Logger.LogError($"Failed to capture {fileNames[step]} (status {status})");
+                            }
+                        });
+                    }
+                    finally
+                    {
+                        if (triggered) SetCameraTriggerMode(0, 0); // back to free-running live view
+                    }
+                    if (saved < 0)
+                    {
+                        throw new InvalidOperationException("Multi-light scan could not start");
                     }
-
-                    // Turn off all lights
-                    SetPlcBit("Y1", 0);
-                    SetPlcBit("Y3", 0);
-                    SetPlcBit("Y4", 0);
-                    SetPlcBit("Y5", 0);
                 });
 
                 // Log to database
@@ -308,10 +416,7 @@ namespace SSApp.UI
                  
                  // Attempt to turn off lights on error
                  try {
-                    SetPlcBit("Y1", 0);
-                    SetPlcBit("Y3", 0);
-                    SetPlcBit("Y4", 0);
-                    SetPlcBit("Y5", 0);
+                    SetLights(false, false, false, false);
                  } catch { }
             }
             finally
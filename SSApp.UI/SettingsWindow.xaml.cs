@@ -27,6 +27,10 @@ namespace SSApp.UI
         [DllImport("SSApp.Native.dll", CallingConvention = CallingConvention.Cdecl, CharSet = CharSet.Ansi)]
         private static extern void SetPlcBit(string device, int value);
 
+        [DllImport("SSApp.Native.dll", CallingConvention = CallingConvention.Cdecl, CharSet = CharSet.Ansi)]
+        [return: MarshalAs(UnmanagedType.I1)]
+        private static extern bool SetPlcBits(string[] devices, int[] values, int count);
+
         private bool _isInitialized = false;
 
         public SettingsWindow()
@@ -234,10 +238,8 @@ namespace SSApp.UI
         {
             try
             {
-                SetPlcBit("Y1", value);
-                SetPlcBit("Y3", value);
-                SetPlcBit("Y4", value);
-                SetPlcBit("Y5", value);
+                string[] devices = { "Y1", "Y3", "Y4", "Y5" };
+                SetPlcBits(devices, new[] { value, value, value, value }, devices.Length);
                 
                 if (value == 1)
                     NotificationService.ShowInfo("Calibration lights ON");
@@ -2,104 +2,292 @@ import socket
 import struct
 import time
 import random
+import threading
+import os
 
 # Configuration
 HOST = '127.0.0.1'
 PORT = 6000
+# Fraction of UDP requests to ignore, to exercise client retries (e.g. SIM_UDP_DROP=0.2)
+UDP_DROP_RATE = float(os.environ.get('SIM_UDP_DROP', '0'))
 
-def create_response(data_bytes):
+# Test devices for the protocol tests: word reads from D7000 up answer with each point's
+# own address (D7005 reads 7005), so a reply shows which request it belongs to. Reads
+# headed at D7500-D7998 are answered DELAYED_REPLY seconds late, while later requests on
+# the same connection are answered at once (4E replies go out of order). Reads headed at
+# D7999 are never answered.
+TEST_HEAD = 7000
+DELAYED_HEAD = 7500
+SILENT_HEAD = 7999
+DELAYED_REPLY = 0.2
+
+# Multi-block reads (0x0406) and monitors (0x0801/0x0802) answer word entries on D7000 and
+# up the same way, and word access to bit devices with a fixed pattern: a bit device is ON
+# when its number is a multiple of 3. Like a real PLC, word access to a bit device must
+# start on a multiple of 16; anything else is refused with END_UNALIGNED. A multi-block
+# read with a block on D7999 is refused with END_REFUSED.
+BIT_CODES = (0x90, 0x92, 0x93, 0xA0, 0x9C, 0x9D)
+END_UNALIGNED = 0xC051
+END_REFUSED = 0xC056
+
+class PlcRefusal(Exception):
+    # Answer the request with this end code and no data
+    def __init__(self, end_code):
+        super().__init__(hex(end_code))
+        self.end_code = end_code
+
+def test_bit_word(first):
+    # 16 bit devices from 'first' in the test pattern, packed like a word read of them
+    return sum(1 << b for b in range(16) if (first + b) % 3 == 0)
+
+def create_response(data_bytes, serial=None, end_code=0):
     # Fixed Header for Response (Subheader D0 00 ...)
     # Network(0), PC(FF), IO(FF 03), Station(0)
     header = b'\xD0\x00\x00\xFF\xFF\x03\x00'
+    if serial is not None:
+        # 4E reply: Subheader D4 00, echoed serial, reserved 00 00
+        header = b'\xD4\x00' + struct.pack('<H', serial) + b'\x00\x00' + header[2:]
     
     # Data Length = EndCode(2) + len(data_bytes)
     total_len = 2 + len(data_bytes)
     len_bytes = struct.pack('<H', total_len)
     
-    # EndCode = 0 (Success)
-    end_code = b'\x00\x00'
+    # EndCode: 0 = success, anything else is the PLC refusing the request
+    return header + len_bytes + struct.pack('<H', end_code) + data_bytes
+
+def process_request(data, monitor):
+    # Basic validation of MC Protocol 3E Frame (Binary)
+    if len(data) < 15 or data[0] != 0x50:
+        print(f"[-] Invalid or short packet: {data.hex()}")
+        return None
+
+    # Parse Command (Bytes 11-12)
+    # Command: 04 01 (Read), 14 01 (Write) - Little Endian in spec, but sent as 01 04 in C++ array
+    # C++: 0x01, 0x04 -> 0x0401
+    cmd_low = data[11]
+    cmd_high = data[12]
+    
+    # Parse Subcommand (Bytes 13-14)
+    # 00 00 (Word), 01 00 (Bit)
+    sub_low = data[13]
+    sub_high = data[14]
+
+    # Parse Device Code (Byte 18) - for logging
+    # D=0xA8, Y=0x9D, etc.
+    if len(data) > 18:
+        dev_code = data[18]
+    else:
+        dev_code = 0
+
+    # Parse Point Count (Bytes 19-20)
+    if len(data) > 20:
+        points = struct.unpack('<H', data[19:21])[0]
+    else:
+        points = 0
+
+    response_data = b''
+
+    # --- LOGIC ---
     
-    return header + len_bytes + end_code + data_bytes
+    # READ COMMAND (0x0401)
+    if cmd_low == 0x01 and cmd_high == 0x04:
+        # Word Read
+        if sub_low == 0x00 and dev_code == 0xA8 and head_number(data) >= TEST_HEAD:
+            print(f"[*] Read Test Word Request (D{head_number(data)}, Count: {points})")
+            for i in range(points):
+                response_data += struct.pack('<H', (head_number(data) + i) & 0xFFFF)
+
+        elif sub_low == 0x00:
+            print(f"[*] Read Word Request (Dev: {hex(dev_code)}, Count: {points})")
+            # Generate random word data (2 bytes per point)
+            # If reading D0 (Device A8), let's return a fluctuating value or incrementing value
+            # just to show activity in the dashboard.
+            for _ in range(points):
+                val = random.randint(100, 200) 
+                response_data += struct.pack('<H', val)
+        
+        # Bit Read
+        elif sub_low == 0x01:
+            print(f"[*] Read Bit Request (Dev: {hex(dev_code)}, Count: {points})")
+            # 1 byte per 2 points (approx)
+            # Python logic in C++ expects enough nibbles.
+            byte_count = (points + 1) // 2
+            response_data = b'\x11' * byte_count # All ON
+
+    # RANDOM READ COMMAND (0x0403)
+    elif cmd_low == 0x03 and cmd_high == 0x04:
+        word_count = data[15]
+        dword_count = data[16]
+        print(f"[*] Random Read Request (Words: {word_count}, DWords: {dword_count})")
+        for _ in range(word_count):
+            response_data += struct.pack('<H', random.randint(100, 200))
+        for _ in range(dword_count):
+            response_data += struct.pack('<I', random.randint(100000, 200000))
+
+    # ENTRY MONITOR DEVICE (0x0801) - remember the list for this connection
+    elif cmd_low == 0x01 and cmd_high == 0x08:
+        print(f"[*] Entry Monitor Request (Words: {data[15]}, DWords: {data[16]})")
+        entries = []
+        for i in range(data[15]):
+            descriptor = data[17 + i * 4:21 + i * 4]
+            entries.append((descriptor[0] | descriptor[1] << 8 | descriptor[2] << 16, descriptor[3]))
+        for number, code in entries:
+            if code in BIT_CODES and number % 16 != 0:
+                print(f"[-] Monitor entry refused (Dev: {hex(code)}, Number: {number})")
+                raise PlcRefusal(END_UNALIGNED)
+        monitor['entries'] = entries
+        monitor['dwords'] = data[16]
+        response_data = b''
+
+    # EXECUTE MONITOR (0x0802) - same reply layout as random read
+    elif cmd_low == 0x02 and cmd_high == 0x08:
+        entries = monitor.get('entries', [])
+        print(f"[*] Execute Monitor Request (Words: {len(entries)}, DWords: {monitor.get('dwords', 0)})")
+        for number, code in entries:
+            if code in BIT_CODES:
+                response_data += struct.pack('<H', test_bit_word(number))
+            elif code == 0xA8 and number >= TEST_HEAD:
+                response_data += struct.pack('<H', number & 0xFFFF)
+            else:
+                response_data += struct.pack('<H', random.randint(100, 200))
+        for _ in range(monitor.get('dwords', 0)):
+            response_data += struct.pack('<I', random.randint(100000, 200000))
+
+    # MULTI-BLOCK READ COMMAND (0x0406)
+    elif cmd_low == 0x06 and cmd_high == 0x04:
+        block_count = data[15] + data[16]
+        print(f"[*] Multi-block Read Request (Word blocks: {data[15]}, Bit blocks: {data[16]})")
+        for i in range(block_count):
+            descriptor = data[17 + i * 6:23 + i * 6]
+            head = descriptor[0] | descriptor[1] << 8 | descriptor[2] << 16
+            code = descriptor[3]
+            block_points = struct.unpack('<H', descriptor[4:6])[0]
+            if code == 0xA8 and head <= SILENT_HEAD < head + block_points:
+                print(f"[-] Block on D{SILENT_HEAD} refused")
+                raise PlcRefusal(END_REFUSED)
+            if i >= data[15]:
+                if code not in BIT_CODES or head % 16 != 0:
+                    print(f"[-] Bit block refused (Dev: {hex(code)}, Head: {head})")
+                    raise PlcRefusal(END_UNALIGNED)
+                for w in range(block_points):
+                    response_data += struct.pack('<H', test_bit_word(head + w * 16))
+            elif code == 0xA8 and head >= TEST_HEAD:
+                for p in range(block_points):
+                    response_data += struct.pack('<H', (head + p) & 0xFFFF)
+            else:
+                for _ in range(block_points):
+                    response_data += struct.pack('<H', random.randint(100, 200))
+
+    # MULTI-BLOCK WRITE COMMAND (0x1406)
+    elif cmd_low == 0x06 and cmd_high == 0x14:
+        print(f"[*] Multi-block Write Request (Word blocks: {data[15]}, Bit blocks: {data[16]})")
+        response_data = b''
+
+    # RANDOM BIT WRITE COMMAND (0x1402)
+    elif cmd_low == 0x02 and cmd_high == 0x14:
+        count = data[15]
+        bits = []
+        for i in range(count):
+            entry = data[16 + i * 5:21 + i * 5]
+            bits.append(f"{hex(entry[3])}:{entry[0] | entry[1] << 8 | entry[2] << 16}={entry[4]}")
+        print(f"[*] Random Bit Write Request ({count}: {' '.join(bits)})")
+        response_data = b''
+
+    # WRITE COMMAND (0x1401)
+    elif cmd_low == 0x01 and cmd_high == 0x14:
+        if sub_low == 0x00:
+            print(f"[*] Write Word Request (Dev: {hex(dev_code)}, Count: {points})")
+        elif sub_low == 0x01:
+            print(f"[*] Write Bit Request (Dev: {hex(dev_code)}, Count: {points})")
+        
+        # Write command just returns EndCode (no data)
+        response_data = b''
+    
+    else:
+        print(f"[?] Unknown Command: {hex(cmd_low)} {hex(cmd_high)}")
+        # Echo empty success for now to prevent crash
+        response_data = b''
+
+    return response_data
+
+def head_number(data):
+    # Head device number of a single-device request (3 bytes, little endian)
+    return data[15] | data[16] << 8 | data[17] << 16
+
+def reply_delay(data):
+    # Seconds to hold the reply to this request back, or None to never answer it
+    if len(data) < 21 or data[11] != 0x01 or data[12] != 0x04 or data[13] != 0x00 or data[18] != 0xA8:
+        return 0
+    head = head_number(data)
+    if head == SILENT_HEAD:
+        return None
+    if DELAYED_HEAD <= head < SILENT_HEAD:
+        return DELAYED_REPLY
+    return 0
+
+def next_frame(buffer):
+    # Split one request off the stream using the header's data-length field.
+    # Returns (3E-layout request, 4E serial or None, remaining buffer).
+    if len(buffer) >= 2 and buffer[0] == 0x54:
+        if len(buffer) < 13:
+            return None, None, buffer
+        frame_len = 13 + struct.unpack('<H', buffer[11:13])[0]
+        if len(buffer) < frame_len:
+            return None, None, buffer
+        serial = struct.unpack('<H', buffer[2:4])[0]
+        # Drop serial + reserved bytes so the rest parses like a 3E frame
+        request = b'\x50\x00' + buffer[6:frame_len]
+        return request, serial, buffer[frame_len:]
+
+    if len(buffer) < 9:
+        return None, None, buffer
+    frame_len = 9 + struct.unpack('<H', buffer[7:9])[0]
+    if len(buffer) < frame_len:
+        return None, None, buffer
+    return buffer[:frame_len], None, buffer[frame_len:]
 
 def handle_client(conn, addr):
     print(f"[+] Connected by {addr}")
+    buffer = b''
+    monitor = {}
+    send_lock = threading.Lock()
+
+    def send_reply(packet):
+        with send_lock:
+            try:
+                conn.sendall(packet)
+            except OSError:
+                pass
+
     try:
         while True:
-            data = conn.recv(1024)
-            if not data:
+            chunk = conn.recv(4096)
+            if not chunk:
                 break
-            
-            # Basic validation of MC Protocol 3E Frame (Binary)
-            if len(data) < 15 or data[0] != 0x50:
-                print(f"[-] Invalid or short packet: {data.hex()}")
-                continue
-
-            # Parse Command (Bytes 11-12)
-            # Command: 04 01 (Read), 14 01 (Write) - Little Endian in spec, but sent as 01 04 in C++ array
-            # C++: 0x01, 0x04 -> 0x0401
-            cmd_low = data[11]
-            cmd_high = data[12]
-            
-            # Parse Subcommand (Bytes 13-14)
-            # 00 00 (Word), 01 00 (Bit)
-            sub_low = data[13]
-            sub_high = data[14]
-
-            # Parse Device Code (Byte 18) - for logging
-            # D=0xA8, Y=0x9D, etc.
-            if len(data) > 18:
-                dev_code = data[18]
-            else:
-                dev_code = 0
+            buffer += chunk
 
-            # Parse Point Count (Bytes 19-20)
-            if len(data) > 20:
-                points = struct.unpack('<H', data[19:21])[0]
-            else:
-                points = 0
-
-            response_data = b''
-
-            # --- LOGIC ---
-            
-            # READ COMMAND (0x0401)
-            if cmd_low == 0x01 and cmd_high == 0x04:
-                # Word Read
-                if sub_low == 0x00:
-                    print(f"[*] Read Word Request (Dev: {hex(dev_code)}, Count: {points})")
-                    # Generate random word data (2 bytes per point)
-                    # If reading D0 (Device A8), let's return a fluctuating value or incrementing value
-                    # just to show activity in the dashboard.
-                    for _ in range(points):
-                        val = random.randint(100, 200) 
-                        response_data += struct.pack('<H', val)
-                
-                # Bit Read
-                elif sub_low == 0x01:
-                    print(f"[*] Read Bit Request (Dev: {hex(dev_code)}, Count: {points})")
-                    # 1 byte per 2 points (approx)
-                    # Python logic in C++ expects enough nibbles.
-                    byte_count = (points + 1) // 2
-                    response_data = b'\x11' * byte_count # All ON
-
-            # WRITE COMMAND (0x1401)
-            elif cmd_low == 0x01 and cmd_high == 0x14:
-                if sub_low == 0x00:
-                    print(f"[*] Write Word Request (Dev: {hex(dev_code)}, Count: {points})")
-                elif sub_low == 0x01:
-                    print(f"[*] Write Bit Request (Dev: {hex(dev_code)}, Count: {points})")
-                
-                # Write command just returns EndCode (no data)
-                response_data = b''
-            
-            else:
-                print(f"[?] Unknown Command: {hex(cmd_low)} {hex(cmd_high)}")
-                # Echo empty success for now to prevent crash
-                response_data = b''
+            while True:
+                data, serial, buffer = next_frame(buffer)
+                if data is None:
+                    break
+
+                try:
+                    response_data = process_request(data, monitor)
+                except PlcRefusal as refusal:
+                    send_reply(create_response(b'', serial, refusal.end_code))
+                    continue
+                if response_data is None:
+                    continue
 
-            # Send Response
-            packet = create_response(response_data)
-            conn.sendall(packet)
+                # Send Response
+                packet = create_response(response_data, serial)
+                delay = reply_delay(data)
+                if delay is None:
+                    print("[*] Request left unanswered")
+                elif delay > 0:
+                    threading.Timer(delay, send_reply, args=(packet,)).start()
+                else:
+                    send_reply(packet)
 
     except ConnectionResetError:
         print("[-] Connection reset by peer")
@@ -109,7 +297,43 @@ def handle_client(conn, addr):
         conn.close()
         print("[-] Connection closed")
 
+def serve_udp():
+    # MC frames over UDP: one request per datagram, reply to the sender. Monitor
+    # registrations are kept per client address, like per connection over TCP.
+    monitors = {}
+    with socket.socket(socket.AF_INET, socket.SOCK_DGRAM) as s:
+        s.bind((HOST, PORT))
+        print(f"=== Mock PLC UDP on {HOST}:{PORT} (drop rate {UDP_DROP_RATE}) ===")
+        while True:
+            try:
+                datagram, addr = s.recvfrom(8192)
+                if random.random() < UDP_DROP_RATE:
+                    print(f"[*] UDP request from {addr} dropped")
+                    continue
+                data, serial, _ = next_frame(datagram)
+                if data is None:
+                    print(f"[-] Short UDP datagram from {addr}: {datagram.hex()}")
+                    continue
+                try:
+                    response_data = process_request(data, monitors.setdefault(addr, {}))
+                except PlcRefusal as refusal:
+                    s.sendto(create_response(b'', serial, refusal.end_code), addr)
+                    continue
+                if response_data is None:
+                    continue
+                packet = create_response(response_data, serial)
+                delay = reply_delay(data)
+                if delay is None:
+                    print(f"[*] UDP request from {addr} left unanswered")
+                elif delay > 0:
+                    threading.Timer(delay, s.sendto, args=(packet, addr)).start()
+                else:
+                    s.sendto(packet, addr)
+            except Exception as e:
+                print(f"UDP server error: {e}")
+
 def main():
+    threading.Thread(target=serve_udp, daemon=True).start()
     with socket.socket(socket.AF_INET, socket.SOCK_STREAM) as s:
         # Allow address reuse
         s.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
@@ -121,7 +345,9 @@ def main():
         while True:
             try:
                 conn, addr = s.accept()
-                handle_client(conn, addr)
+                conn.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+                # One thread per client so several connections (PlcOpen handles) can share the mock PLC
+                threading.Thread(target=handle_client, args=(conn, addr), daemon=True).start()
             except KeyboardInterrupt:
                 print("\nStopping server...")
                 break